@@ -5,9 +5,11 @@
 #include <cassert>
 #include <cmath>
 #include <limits>
+#include <algorithm>
 
 #include "Cell.h"
 #include "Particle.h"
+#include "Lattice.h"
 
 // take in a pair of surface pointer and integer describing sense (must not be zero!)
 // and append to vector of surfaces
@@ -17,28 +19,53 @@ void cell::addSurface( std::shared_ptr< surface > S, int sense ) {
   int sgn = std::copysign( 1, sense );
 
   surfaces.push_back( std::make_pair( S, sgn ) );
+  if ( ! S->convex( sgn ) ) { convex_cell = false; }
+
+  // the cell lies inside the box of every surface bounding it, widened a little so
+  // points on a surface are never rejected by roundoff in the box
+  S->bound( sgn, bound_lo, bound_hi );
+  auto widen = []( double v, double dir ) {
+    if ( std::fabs( v ) == std::numeric_limits<double>::max() ) { return v; }
+    return v + dir * std::numeric_limits<float>::epsilon() * std::fmax( 1.0, std::fabs( v ) );
+  };
+  box_lo = point( widen( bound_lo.x, -1.0 ), widen( bound_lo.y, -1.0 ), widen( bound_lo.z, -1.0 ) );
+  box_hi = point( widen( bound_hi.x,  1.0 ), widen( bound_hi.y,  1.0 ), widen( bound_hi.z,  1.0 ) );
+}
+
+bool cell::hasEstimators() {
+  if ( ! cell_estimators.empty() ) { return true; }
+  for ( auto s : surfaces ) {
+    if ( s.first->hasEstimators() ) { return true; }
+  }
+  return false;
 }
 
-// test if point p inside the current cell
-bool cell::testPoint( point p ) {
+// test if point p inside the current cell, p lying on surface on with the given sense if on is not null
+bool cell::testPoint( point p, surface* on, int sense ) {
+
+  // cheap rejection of points outside the box around the cell
+  if ( ! inBox( p ) ) { return false; }
 
   // loop over surfaces in cell, if not on correct side return false
   // if on correct side of all surfaces, particle is in the cell and return true
   for ( auto s : surfaces ) {
     // first = surface pointer, second = +/- 1 indicating sense
-    if ( s.first->eval( p ) * s.second < 0 ) { return false; }  
+    if ( s.first.get() == on ) {
+      if ( s.second != sense ) { return false; }
+    }
+    else if ( s.first->eval( p ) * s.second < 0 ) { return false; }  
   }
   return true;
 }
 
-// find first intersecting surface of ray r and distance to intersection
-std::pair< std::shared_ptr< surface >, double > cell::surfaceIntersect( ray r ) {
+// find first intersecting surface of ray r and distance to intersection, r starting on surface on if not null
+std::pair< std::shared_ptr< surface >, double > cell::surfaceIntersect( ray r, surface* on ) {
 
   double dist = std::numeric_limits<double>::max();
   std::shared_ptr< surface > S = nullptr;
   for ( auto s : surfaces ) {
     // first is a surface pointer; distance is always positive or huge if invalid
-    double d = s.first->distance( r );
+    double d = s.first.get() == on ? s.first->distanceFrom( r ) : s.first->distance( r );
     if ( d < dist ) {
       // current surface intersection is closer
       dist = d;
@@ -48,13 +75,65 @@ std::pair< std::shared_ptr< surface >, double > cell::surfaceIntersect( ray r )
   return std::make_pair( S, dist );
 }
 
-void cell::moveParticle( particle* p, double s ) {
-  p->move( s - std::numeric_limits<float>::epsilon() ); // move particle within epsilon of location which may be cell boundary
-  scoreEstimators( p );
-  p->move( std::numeric_limits<float>::epsilon() );        // finish moving particle to scary boundary
+double cell::safety( point p ) {
+  double s = std::numeric_limits<double>::max();
+  for ( const auto& S : surfaces ) { s = std::fmin( s, S.first->safety( p ) ); }
+  return s;
+}
+
+// sample the distance to the next collision, applying forced collisions or the exponential transform
+double cell::sampleDistance( particle* p, double dist_surface, std::stack<particle>* bank ) {
+  double xs = macro_xs( p );
+  if ( p->uncollided() ) { return std::numeric_limits<double>::max(); }
+
+  // forced collision: the uncollided part of the weight is banked to stream to the boundary,
+  // the collided part collides within the cell at a distance sampled from the truncated exponential
+  if ( forced_collision && ! p->forced() && xs > 0.0 && dist_surface < std::numeric_limits<double>::max() ) {
+    double P = -std::expm1( -xs * dist_surface );  // probability of colliding before the boundary
+    if ( P < 1.0 ) {
+      particle q = *p;
+      q.adjustWeight( 1.0 - P );
+      q.setUncollided( true );
+      bank->push( q );
+    }
+    p->adjustWeight( P );
+    p->setForced( true );
+    return -std::log1p( -Urand() * P ) / xs;
+  }
+
+  // exponential transform: sample with the stretched cross section xs * ( 1 - p mu ),
+  // moveParticle corrects the weight once the end of the flight is known
+  if ( exp_stretch != 0.0 ) {
+    point  u  = p->dir();
+    double mu = u.x * exp_direction.x + u.y * exp_direction.y + u.z * exp_direction.z;
+    return -std::log( Urand() ) / ( xs * ( 1.0 - exp_stretch * mu ) );
+  }
+
+  return -std::log( Urand() ) / xs;
+}
+
+void cell::moveParticle( particle* p, double s, bool collision ) {
+  // under the exponential transform the weight decays along the flight as exp( -( xs - xs* ) x ),
+  // so estimators see the integral of the weight along the track and the weight is corrected at the end
+  double dx     = 0.0;                              // xs - xs*
+  double factor = 1.0;
+  if ( exp_stretch != 0.0 && ! p->uncollided() ) {
+    double xs = macro_xs( p );
+    point  u  = p->dir();
+    double mu = u.x * exp_direction.x + u.y * exp_direction.y + u.z * exp_direction.z;
+    dx     = xs * exp_stretch * mu;
+    factor = std::exp( -dx * s );
+    if ( collision ) { factor *= xs / ( xs - dx ); }
+  }
+
+  p->move( s );                                            // move particle, possibly onto the cell boundary
+  scoreEstimators( p, s, dx );
+  if ( factor != 1.0 ) { p->adjustWeight( factor ); }
 }
 
 void cell::sampleCollision( particle* p, std::stack<particle>* bank ) {
+  p->setCollided( true );
+  p->countCollision();
   cell_material->sample_collision( p, bank );
 }
 
@@ -62,8 +141,208 @@ void cell::sampleCollision( particle* p, std::stack<particle>* bank ) {
   // this will be nonsensical for problem 5.
 }*/
 
-void cell::scoreEstimators( particle* p ) {
+void cell::scoreEstimators( particle* p, double s, double decay ) {
   for ( auto e : cell_estimators ) { 
-    e->score( p ); 
+    e->scoreFlight( p, s, decay ); 
   }     // score estimators
 }
+
+void cell::scoreCollision( particle* p ) {
+  for ( auto e : cell_estimators ) { e->scoreCollision( p ); }
+}
+
+cell_group::cell_group( std::vector< std::shared_ptr< cell > > cells ) : group_cells(cells) {
+  for ( auto c : group_cells ) {
+    std::vector< int > indices, signs;
+    for ( auto s : c->surfaceList() ) {
+      int i = std::find( group_surfaces.begin(), group_surfaces.end(), s.first ) - group_surfaces.begin();
+      if ( i == (int) group_surfaces.size() ) { group_surfaces.push_back( s.first ); }
+      indices.push_back( i );
+      signs.push_back( s.second );
+    }
+    cell_surfaces.push_back( indices );
+    cell_senses.push_back( signs );
+    rejects.push_back( std::vector< unsigned long long > ( indices.size(), 0 ) );
+  }
+  queries = 0;
+
+  words = ( group_surfaces.size() + 63 ) / 64;
+  known.resize( words ); positive.resize( words ); negative.resize( words );
+}
+
+std::shared_ptr< cell > cell_group::find( point p, surface* on, int sense ) {
+  bool warmup = queries < warmup_queries;
+  if ( warmup && ++queries == warmup_queries ) { reorder(); }
+
+  std::fill( known.begin(), known.end(), 0 );
+  for ( int c = group_cells.size() - 1 ; c >= 0 ; c-- ) {
+    if ( ! group_cells[c]->inBox( p ) ) { continue; }
+
+    // evaluate the surfaces of this cell not seen yet in this query, a point on a surface
+    // counts as being on both sides of it, except on the surface the particle crossed
+    bool match = true;
+    for ( int k = 0 ; k < (int) cell_surfaces[c].size() ; k++ ) {
+      int      i   = cell_surfaces[c][k];
+      uint64_t bit = (uint64_t) 1 << ( i % 64 );
+      int      w   = i / 64;
+      if ( ! ( known[w] & bit ) ) {
+        known[w] |= bit;
+        double v = group_surfaces[i].get() == on ? sense : group_surfaces[i]->eval( p );
+        if ( v >= 0.0 ) { positive[w] |= bit; } else { positive[w] &= ~bit; }
+        if ( v <= 0.0 ) { negative[w] |= bit; } else { negative[w] &= ~bit; }
+      }
+      if ( ! ( ( cell_senses[c][k] > 0 ? positive[w] : negative[w] ) & bit ) ) {
+        match = false;
+        if ( ! warmup ) { break; }
+        rejects[c][k]++;
+      }
+    }
+    if ( match ) { return group_cells[c]; }
+  }
+  return nullptr;
+}
+
+void cell_group::reorder() {
+  for ( int c = 0 ; c < (int) group_cells.size() ; c++ ) {
+    std::vector< int > order( cell_surfaces[c].size() );
+    for ( int k = 0 ; k < (int) order.size() ; k++ ) { order[k] = k; }
+    auto rate = [&]( int k ) { return rejects[c][k] / group_surfaces[ cell_surfaces[c][k] ]->evalCost(); };
+    std::stable_sort( order.begin(), order.end(), [&]( int a, int b ) { return rate( a ) > rate( b ); } );
+
+    std::vector< int > indices, signs;
+    for ( int k : order ) { indices.push_back( cell_surfaces[c][k] ); signs.push_back( cell_senses[c][k] ); }
+    cell_surfaces[c] = indices;
+    cell_senses[c]   = signs;
+  }
+}
+
+// descend from cells to the material cell at the particle position
+static bool locateIn( particle* p, cell_group& cells ) {
+  std::vector< geometry_level > levels;
+  cell_group* candidates = &cells;
+  point  pos    = p->pos();
+  point  offset = point( 0.0, 0.0, 0.0 );
+  while ( true ) {
+    point local = point( pos.x - offset.x, pos.y - offset.y, pos.z - offset.z );
+    surface* on = p->onSurface() && p->surfaceOffset() == offset ? p->onSurface() : nullptr;
+    std::shared_ptr< cell > found = candidates->find( local, on, p->surfaceSense() );
+    if ( ! found ) { return false; }
+    if ( ! found->isFilled() ) {
+      p->recordLocation( found, offset, levels );
+      return true;
+    }
+
+    // descend into the fill, translating to its coordinates
+    point o = found->fillOrigin();
+    point inner = point( offset.x + o.x, offset.y + o.y, offset.z + o.z );
+    if ( found->filledUniverse() ) {
+      levels.push_back( geometry_level( found, offset, -1 ) );
+      candidates = &( found->filledUniverse()->group() );
+    }
+    else {
+      std::shared_ptr< lattice > L = found->filledLattice();
+      int   e = L->index( ray( point( pos.x - inner.x, pos.y - inner.y, pos.z - inner.z ), p->dir() ) );
+      point c = L->center( e );
+      levels.push_back( geometry_level( found, offset, e ) );
+      inner = point( inner.x + c.x, inner.y + c.y, inner.z + c.z );
+      candidates = &( L->element( e )->group() );
+    }
+    offset = inner;
+  }
+}
+
+// a particle on a surface it crossed that no cell claims has met a different surface coinciding with it,
+// it is stepped off both by a small distance relative to its coordinates and located again
+bool locateParticle( particle* p, cell_group& cells ) {
+  if ( locateIn( p, cells ) ) { return true; }
+  if ( ! p->onSurface() ) { return false; }
+  particle q = *p;
+  point    x = q.pos();
+  double   scale = std::fmax( 1.0, std::fmax( std::fabs( x.x ), std::fmax( std::fabs( x.y ), std::fabs( x.z ) ) ) );
+  q.move( std::numeric_limits<float>::epsilon() * scale );
+  if ( ! locateIn( &q, cells ) ) { return false; }
+  *p = q;
+  return true;
+}
+
+std::pair< std::shared_ptr< surface >, double > boundaryIntersect( particle* p, point& offset ) {
+  // the surface the particle sits on only counts in the coordinates it was crossed in
+  surface* on = p->onSurface() && p->surfaceOffset() == p->localOffset() ? p->onSurface() : nullptr;
+  std::pair< std::shared_ptr< surface >, double > S = p->cellPointer()->surfaceIntersect( p->localRay(), on );
+  offset = p->localOffset();
+  for ( auto l : p->levels() ) {
+    point pos = point( p->pos().x - l.offset.x, p->pos().y - l.offset.y, p->pos().z - l.offset.z );
+    on = p->onSurface() && p->surfaceOffset() == l.offset ? p->onSurface() : nullptr;
+    std::pair< std::shared_ptr< surface >, double > T = l.level_cell->surfaceIntersect( ray( pos, p->dir() ), on );
+    if ( T.second < S.second ) { S = T; offset = l.offset; }
+    if ( l.element >= 0 ) {
+      point  o = l.level_cell->fillOrigin();
+      double d = l.level_cell->filledLattice()->distance( ray( point( pos.x - o.x, pos.y - o.y, pos.z - o.z ), p->dir() ), l.element );
+      if ( d < S.second ) { S = std::make_pair( nullptr, d ); }
+    }
+  }
+  return S;
+}
+
+double safetyDistance( particle* p ) {
+  double s = p->cellPointer()->safety( p->localPos() );
+  for ( auto l : p->levels() ) {
+    point pos = point( p->pos().x - l.offset.x, p->pos().y - l.offset.y, p->pos().z - l.offset.z );
+    s = std::fmin( s, l.level_cell->safety( pos ) );
+    if ( l.element >= 0 ) {
+      point o = l.level_cell->fillOrigin();
+      s = std::fmin( s, l.level_cell->filledLattice()->safety( point( pos.x - o.x, pos.y - o.y, pos.z - o.z ) ) );
+    }
+  }
+  return s;
+}
+
+// walk the segment cell by cell, summing macro xs times chord length
+double opticalDepth( particle* p, point b, cell_group& cells, particle* end ) {
+  point  a = p->pos();
+  point  u = point( b.x - a.x, b.y - a.y, b.z - a.z );
+  double remaining = std::sqrt( u.x * u.x + u.y * u.y + u.z * u.z );
+  if ( remaining == 0.0 ) { return 0.0; }
+
+  particle q = *p;
+  q.setDirection( u );
+  if ( q.onSurface() ) {
+    // the side of the surface a particle sitting on it moves into depends on the direction
+    point o = q.surfaceOffset();
+    q.setSurface( q.onSurface(), q.onSurface()->senseAlong( ray( point( a.x - o.x, a.y - o.y, a.z - o.z ), q.dir() ) ), o );
+  }
+  double tau = 0.0;
+  while ( true ) {
+    std::shared_ptr< cell > c = q.cellPointer();
+    if ( ! c || c->getImportance() == 0.0 ) { return std::numeric_limits<double>::infinity(); } // left the problem
+    point  o;
+    std::pair< std::shared_ptr< surface >, double > S = boundaryIntersect( &q, o );
+    double d = S.second;
+    if ( d >= remaining ) {
+      if ( end ) {
+        // a boundary through b, up to rounding of the two intersections, is crossed as a particle would cross it
+        double scale = std::fmax( 1.0, std::fmax( std::fabs( b.x ), std::fmax( std::fabs( b.y ), std::fabs( b.z ) ) ) );
+        double tol   = std::numeric_limits<float>::epsilon() * scale;
+        if ( S.first && d - remaining <= tol ) {
+          q.move( d );
+          point x = q.pos();
+          q.setSurface( S.first.get(), S.first->senseAlong( ray( point( x.x - o.x, x.y - o.y, x.z - o.z ), q.dir() ) ), o );
+          locateParticle( &q, cells );
+        }
+        else if ( ! q.onSurface() || remaining > tol ) { q.move( remaining ); }
+        *end = q;
+      }
+      return tau + c->macro_xs( &q ) * remaining;
+    }
+
+    // step onto the boundary, as particles do, and find the next cell from the side of it moved into
+    tau       += c->macro_xs( &q ) * d;
+    remaining -= d;
+    q.move( d );
+    if ( S.first ) {
+      point x = q.pos();
+      q.setSurface( S.first.get(), S.first->senseAlong( ray( point( x.x - o.x, x.y - o.y, x.z - o.z ), q.dir() ) ), o );
+    }
+    if ( ! locateParticle( &q, cells ) ) { return std::numeric_limits<double>::infinity(); }
+  }
+}
@@ -6,12 +6,16 @@
 #include <utility>
 #include <memory>
 #include <limits>
+#include <cstdint>
 
 #include "Point.h"
 #include "Surface.h"
 #include "Material.h"
 #include "Estimator.h"
 
+class universe;
+class lattice;
+
 class cell {
   private:
     std::string cell_name;                                                // name of cell
@@ -19,9 +23,28 @@ class cell {
     std::shared_ptr< material > cell_material;                            // pointer to material in cell
     std::vector< std::shared_ptr< estimator > > cell_estimators;          // estimators tracking in cell
     double importance;                                                    // importance of cell to decide particle weights
+    int cell_index;                                                       // position of cell in the problem's cell list
+    bool forced_collision;                                                // true if particles entering are forced to collide
+    double exp_stretch;                                                   // exponential transform parameter (0 = off)
+    point exp_direction;                                                  // preferred direction of the exponential transform
+    int delta_region;                                                     // delta tracking region of the cell (-1 = surface tracking)
+    bool convex_cell;                                                     // true if every surface bounds the cell on a convex side
+    point bound_lo, bound_hi;                                             // box around the cell from its bounded surfaces
+    point box_lo, box_hi;                                                 // the same box widened for roundoff, for rejecting points
+    std::shared_ptr< universe > fill_universe;                            // universe filling the cell (null if none)
+    std::shared_ptr< lattice > fill_lattice;                              // lattice filling the cell (null if none)
+    point fill_origin;                                                    // origin of the fill in the cell's coordinates
+    unsigned long long safety_tries, safety_hits;                         // recent safety distances computed, and flights they kept inside
+    unsigned long long safety_skips;                                      // flights sampled second since safety distances stopped paying off
   public:
 
-    cell( std::string label ) : cell_name(label) { importance = 1.0; };   // constructor takes name and assumes importance 1.0
+    cell( std::string label ) : cell_name(label) {                        // constructor takes name and assumes importance 1.0
+      importance = 1.0; cell_index = -1; forced_collision = false; exp_stretch = 0.0; 
+      delta_region = -1; convex_cell = true; safety_tries = 0; safety_hits = 0; safety_skips = 0;
+      double inf = std::numeric_limits<double>::max();
+      bound_lo = point( -inf, -inf, -inf ); bound_hi = point( inf, inf, inf );
+      box_lo = bound_lo; box_hi = bound_hi;
+    };
     ~cell() {};                                                           // destructor
 
     std::string name() { return cell_name; };                             // return cell name
@@ -29,18 +52,103 @@ class cell {
     std::shared_ptr< material > getMaterial() { return cell_material; }   // return pointer to material in cell
     void setImportance( double imp ) { importance = imp; };               // set importance of cell
     double getImportance() { return importance; }                         // return importance of cell
+    void setIndex( int i ) { cell_index = i; };                           // set position in the problem's cell list
+    int getIndex() { return cell_index; };                                // return position in the problem's cell list
     void addSurface( std::shared_ptr< surface > S, int sense );           // add a surface defining the cell
     void attachEstimator( std::shared_ptr< estimator > E ) { cell_estimators.push_back( E ); }; // add an estimator
-    bool testPoint( point p );                                            // true if point p is inside the cell
-    std::pair< std::shared_ptr< surface >, double > surfaceIntersect( ray r );                  // return first surface ray r will intersect and distance to intersection
-    double macro_xs() {                                                   // return macro xs of the material in the cell
-      if ( cell_material ) { return getMaterial()->macro_xs(); }
+    bool testPoint( point p, surface* on = nullptr, int sense = 0 );      // true if point p is inside the cell, p on surface on with sense
+    bool isConvex() { return convex_cell; };                              // true if segments between points of the cell stay in it
+    bool  inBox( point p ) {                                              // false if p is certainly outside the cell
+      return p.x >= box_lo.x && p.x <= box_hi.x && p.y >= box_lo.y && p.y <= box_hi.y && p.z >= box_lo.z && p.z <= box_hi.z;
+    };
+    std::vector< std::pair< std::shared_ptr< surface >, int > >& surfaceList() { return surfaces; }; // surfaces and senses
+    point boundLow()  { return bound_lo; };                               // lower corner of the box around the cell
+    point boundHigh() { return bound_hi; };                               // upper corner of the box around the cell
+    int  numSurfaces() { return surfaces.size(); };                       // number of surfaces defining the cell
+    bool hasEstimators();                                                 // true if tracks in the cell or crossings of its surfaces are scored
+    bool hasVarianceReduction() { return forced_collision || exp_stretch != 0.0; }; // true if flights are not sampled analog
+    void setDeltaRegion( int r ) { delta_region = r; };                   // put the cell in delta tracking region r
+    int  getDeltaRegion() { return delta_region; };                       // delta tracking region of the cell (-1 = surface tracking)
+    void setFill( std::shared_ptr< universe > U, point origin ) { fill_universe = U; fill_origin = origin; }; // fill with a universe
+    void setFill( std::shared_ptr< lattice > L, point origin ) { fill_lattice = L; fill_origin = origin; };   // fill with a lattice
+    std::shared_ptr< universe > filledUniverse() { return fill_universe; }; // universe filling the cell (null if none)
+    std::shared_ptr< lattice > filledLattice() { return fill_lattice; };    // lattice filling the cell (null if none)
+    point fillOrigin() { return fill_origin; };                           // origin of the fill in the cell's coordinates
+    bool  isFilled() { return fill_universe || fill_lattice; };           // true if the cell holds a universe or lattice instead of material
+    std::pair< std::shared_ptr< surface >, double > surfaceIntersect( ray r, surface* on = nullptr ); // return first surface ray r will intersect and distance to intersection
+    double safety( point p );                                             // lower bound on the distance from p to the cell boundary
+    // true if the flight of p can be sampled before the boundary distance is known, and safety distances
+    // pay off in this cell: at least half of those computed recently kept the flight inside, saving an intersection;
+    // while they do not, every 64th flight still tries one so the cell can switch back when its flights change
+    bool sampleFlightFirst( particle* p ) {
+      if ( p->uncollided() || ( forced_collision && ! p->forced() ) ) { return false; }
+      if ( safety_tries < 256 || 2 * safety_hits >= safety_tries ) { return true; }
+      return ++safety_skips % 64 == 0;
+    };
+    void recordSafety( bool hit ) {                                       // count a computed safety distance, halving the counts
+      safety_tries++; if ( hit ) { safety_hits++; }                       // at 512 so they follow the last few hundred
+      if ( safety_tries == 512 ) { safety_tries /= 2; safety_hits /= 2; }
+    };
+    double macro_xs( particle* p ) {                                      // return macro xs of the material in the cell for particle p
+      if ( cell_material ) { return cell_material->macro_xs( p ); }
+      else { return 0.0; }
+    };
+    double majorant( int g ) {                                            // return the largest macro xs of the cell in group g
+      if ( cell_material ) { return cell_material->majorant( g ); }
       else { return 0.0; }
     };
-    void moveParticle( particle* p, double s );                           // move particle to cell edge and scores estimators
+    void setForcedCollision( bool f ) { forced_collision = f; };          // force particles entering the cell to collide
+    void setExponentialTransform( double p, point d ) {                   // stretch flights along d with parameter p
+      exp_stretch = p; exp_direction = d; exp_direction.normalize();
+    };
+    double sampleDistance( particle* p, double dist_surface, std::stack<particle>* bank ); // sample distance to collision
+    void moveParticle( particle* p, double s, bool collision = false );   // move particle to cell edge and scores estimators
     void sampleCollision( particle* p, std::stack<particle>* bank );      // sample collision according to material method
 //    double volume();                                                      // return volume of cell
-    void scoreEstimators( particle* p );                                  // score cell estimators
+    void scoreEstimators( particle* p, double s, double decay );          // score cell estimators for a flight of length s, the weight
+                                                                          // decaying along it as exp( -decay x )
+    void scoreCollision( particle* p );                                   // score cell estimators for a collision, before it is sampled
 };
 
+// the cells of one universe and the distinct surfaces they share: a point location query evaluates each
+// surface at most once, keeping the side of the surfaces seen so far in bitsets, and a cell is rejected at
+// the first of its surfaces on the wrong side; cells are tried last to first so the result, like a scan of
+// testPoint over the cells, is the last cell containing the point
+// during the first warmup_queries queries a cell tested is tested against all its surfaces, counting each one
+// the point is on the wrong side of, so a surface's count is its rejection rate whatever its place in the order;
+// then the surfaces are reordered by rejections per unit eval cost, so later queries reject after fewer evals
+class cell_group {
+  private:
+    static const unsigned int warmup_queries = 4096;
+    std::vector< std::shared_ptr< cell > > group_cells;        // cells of the universe
+    std::vector< std::shared_ptr< surface > > group_surfaces;  // distinct surfaces of the cells
+    std::vector< std::vector< int > > cell_surfaces;           // indices of the surfaces of each cell, in test order
+    std::vector< std::vector< int > > cell_senses;             // sense of each of those surfaces
+    std::vector< std::vector< unsigned long long > > rejects;  // times each of those surfaces was on the wrong side during warm-up
+    unsigned int queries;                                      // queries made, counted up to warmup_queries
+    int words;                                                 // 64 bit words per bitset
+    std::vector< uint64_t > known, positive, negative;         // per query: surfaces evaluated, with eval >= 0, with eval <= 0
+    void reorder();                                            // sort the surfaces of each cell by rejections per cost
+  public:
+     cell_group( std::vector< std::shared_ptr< cell > > cells );
+    ~cell_group() {};
+
+    std::vector< std::shared_ptr< cell > >& cells() { return group_cells; };
+    std::shared_ptr< cell > find( point p, surface* on = nullptr, int sense = 0 ); // cell containing p, p on surface on with sense
+};
+
+// navigation through nested universes, starting from the cells of the outermost universe:
+// locateParticle descends through filled cells to the cell holding material at the particle position,
+// using the known side of a surface the particle sits on and stepping it off any surface coinciding with that one,
+// leaving the particle unchanged and returning false if no cell contains it
+bool locateParticle( particle* p, cell_group& cells );
+// nearest boundary of the particle's cell or of any filled cell or lattice element above it, offset is set to global
+// minus local coordinates of the surface; the surface is null for lattice element boundaries, which have nothing to score or reflect
+std::pair< std::shared_ptr< surface >, double > boundaryIntersect( particle* p, point& offset );
+// safety distance of the particle: no boundary of its cell, the filled cells or the lattice element above it is closer
+double safetyDistance( particle* p );
+// optical depth from particle p to b in its group or at its energy; infinite if the segment leaves the problem
+// if end is given it is left at b, on the boundary there and on the side moved into if b lies on one
+double opticalDepth( particle* p, point b, cell_group& cells, particle* end = nullptr );
+
 #endif
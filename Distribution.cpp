@@ -17,6 +17,11 @@ double linear_distribution::sample() {
   }
 }
 
+double linear_distribution::pdf( double x ) {
+  if ( x < a || x > b ) { return 0.0; }
+  return ( fa + ( fb - fa ) * ( x - a ) / ( b - a ) ) / ( 0.5 * ( fa + fb ) * ( b - a ) );
+}
+
 double exponential_distribution::sample() { return -std::log( Urand() ) / lambda; }
 
 double normal_distribution::sample() 
@@ -31,6 +36,10 @@ double HenyeyGreenstein_distribution::sample() {
   }
 }
 
+double HenyeyGreenstein_distribution::pdf( double mu ) {
+  return 0.5 * ( 1.0 - a*a ) / std::pow( 1.0 + a*a - 2.0 * a * mu, 1.5 );
+}
+
 int meanMultiplicity_distribution::sample() {
   return (int) std::floor( nu + Urand() );
 }
@@ -61,6 +70,13 @@ int TerrellFission_distribution::sample() {
  return nu; 
 }
 
+// expected multiplicity is the sum over n of P( N > n )
+double TerrellFission_distribution::mean() {
+  double m = 0.0;
+  for ( auto c : cdf ) { m += 1.0 - c; }
+  return m;
+}
+
 point isotropicDirection_distribution::sample() {
   // sample polar cosine and azimuthal angle uniformly
   double mu  = 2.0 * Urand() - 1.0;
@@ -97,3 +113,10 @@ point anisotropicDirection_distribution::sample() {
 point independentXYZ_distribution::sample() {
   return point( dist_x->sample(), dist_y->sample(), dist_z->sample() );
 }
+
+bool independentXYZ_distribution::sameKind( distribution<point>& other ) {
+  independentXYZ_distribution* xyz = dynamic_cast< independentXYZ_distribution* >( &other );
+  if ( ! xyz ) { return distribution<point>::sameKind( other ); }
+  return dist_x->singular() == xyz->dist_x->singular() && dist_y->singular() == xyz->dist_y->singular() 
+      && dist_z->singular() == xyz->dist_z->singular();
+}
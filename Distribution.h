@@ -22,6 +22,19 @@ class distribution {
 
     virtual std::string name() final { return distribution_name; };
     virtual T sample() = 0;  // dummy function that must be implemented in each case
+    virtual double pdf( T ) {                                         // probability density of a value (per steradian for directions)
+      std::cout << " probability density not available for distribution " << name() << std::endl;
+      throw;
+    };
+    virtual double mean() {                                           // expected value of a number valued distribution
+      std::cout << " mean not available for distribution " << name() << std::endl;
+      throw;
+    };
+    virtual bool singular() { return false; };                        // true if there is no density, pdf() is then the probability
+    virtual bool mixed() { return false; };                           // true if some coordinates are singular and others not
+    virtual bool sameKind( distribution<T>& other ) {                 // true if pdf() ratios with other are weights,
+      return ! mixed() && ! other.mixed() && singular() == other.singular(); // both densities or both probabilities
+    };
 };
 
 template <class T>
@@ -33,8 +46,20 @@ class arbitraryDelta_distribution : public distribution<T> {
     ~arbitraryDelta_distribution() {};
 
     T sample() { return result; }
+    double pdf( T x ) { return x == result ? 1.0 : 0.0; }
+    double mean();
+    bool singular() { return true; };
 };
 
+template < class T >
+double arbitraryDelta_distribution<T>::mean() { return distribution<T>::mean(); }
+
+template <>
+inline double arbitraryDelta_distribution<int>::mean() { return result; }
+
+template <>
+inline double arbitraryDelta_distribution<double>::mean() { return result; }
+
 template <class T>
 class arbitraryDiscrete_distribution : public distribution<T> {
   private:
@@ -43,6 +68,8 @@ class arbitraryDiscrete_distribution : public distribution<T> {
      arbitraryDiscrete_distribution( std::string label, std::vector< std::pair< T, double > > data );
     ~arbitraryDiscrete_distribution() {};
      T sample();
+     double pdf( T x );                         // probability of drawing x
+     bool singular() { return true; };
 };
 
 template < class T >
@@ -68,6 +95,18 @@ T arbitraryDiscrete_distribution<T>::sample() {
   return cdf.back().first; 
 }
 
+template < class T >
+double arbitraryDiscrete_distribution<T>::pdf( T x ) {
+  double p = 0.0;
+  double c = 0.0;
+  for ( auto d : cdf ) {
+    // the same value may be listed more than once
+    if ( d.first == x ) { p += d.second - c; }
+    c = d.second;
+  }
+  return p / cdf.back().second;
+}
+
 class delta_distribution : public distribution<double> {
   private:
     double a;
@@ -75,6 +114,8 @@ class delta_distribution : public distribution<double> {
      delta_distribution( std::string label, double p1 ) : distribution(label), a(p1) {};
     ~delta_distribution() {};
     double sample() { return a; };
+    double pdf( double x ) { return x == a ? 1.0 : 0.0; };
+    bool singular() { return true; };
 };
 
 class uniform_distribution : public distribution<double> {
@@ -84,6 +125,8 @@ class uniform_distribution : public distribution<double> {
      uniform_distribution( std::string label, double p1, double p2 ) : distribution(label), a(p1), b(p2) {};
     ~uniform_distribution() {};
     double sample();
+    double pdf( double x ) { return ( x >= a && x <= b ) ? 1.0 / ( b - a ) : 0.0; };
+    double mean() { return 0.5 * ( a + b ); };
 };
 
 class linear_distribution : public distribution<double> {
@@ -94,6 +137,7 @@ class linear_distribution : public distribution<double> {
       : distribution(label), a(x1), b(x2), fa(y1), fb(y2) {};
    ~linear_distribution() {};
    double sample();
+   double pdf( double x );
 };
 
 class exponential_distribution : distribution<double> {
@@ -122,6 +166,7 @@ class HenyeyGreenstein_distribution : public distribution<double> {
      HenyeyGreenstein_distribution( std::string label, double p1 ) : distribution(label), a(p1) {};
     ~HenyeyGreenstein_distribution() {};
     double sample();
+    double pdf( double mu );
 };
 
 class meanMultiplicity_distribution : public distribution<int> {
@@ -131,6 +176,7 @@ class meanMultiplicity_distribution : public distribution<int> {
      meanMultiplicity_distribution( std::string label, double p1 ) : distribution(label), nu(p1) {};
     ~meanMultiplicity_distribution() {};
     int sample();
+    double mean() { return nu; };
 };
 
 class TerrellFission_distribution : public distribution<int> {
@@ -141,6 +187,7 @@ class TerrellFission_distribution : public distribution<int> {
     TerrellFission_distribution( std::string label, double p1, double p2, double p3 );
     ~TerrellFission_distribution() {};
     int sample();
+    double mean();
 };
 
 class isotropicDirection_distribution : public distribution<point> {
@@ -150,6 +197,7 @@ class isotropicDirection_distribution : public distribution<point> {
      isotropicDirection_distribution( std::string label ) : distribution(label) {};
     ~isotropicDirection_distribution() {};
     point sample();
+    double pdf( point ) { return 1.0 / ( 2.0 * twopi ); };
 };
 
 class anisotropicDirection_distribution : public distribution<point> {
@@ -164,6 +212,8 @@ class anisotropicDirection_distribution : public distribution<point> {
        { axis.normalize(); sin_t = std::sqrt( 1.0 - axis.z * axis.z ); };
     ~anisotropicDirection_distribution() {};
     point sample();
+    double pdf( point u ) { return dist_mu->pdf( u.x * axis.x + u.y * axis.y + u.z * axis.z ) / twopi; };
+    bool singular() { return dist_mu->singular(); };
 };
 
 class independentXYZ_distribution : public distribution<point> {
@@ -176,6 +226,10 @@ class independentXYZ_distribution : public distribution<point> {
     ~independentXYZ_distribution() {};
 
     point sample();
+    double pdf( point p ) { return dist_x->pdf( p.x ) * dist_y->pdf( p.y ) * dist_z->pdf( p.z ); };
+    bool singular() { return dist_x->singular() || dist_y->singular() || dist_z->singular(); };  // a delta along any axis
+    bool mixed() { return singular() && ! ( dist_x->singular() && dist_y->singular() && dist_z->singular() ); };
+    bool sameKind( distribution<point>& other );   // compared axis by axis with other independent coordinates
 };
 
 #endif
@@ -0,0 +1,72 @@
+#include <iostream>
+#include <cmath>
+#include <limits>
+
+#include "Random.h"
+#include "Dxtran.h"
+
+dxtran_sphere::dxtran_sphere( point c, double r, double wc, double ws, std::shared_ptr< cell_group > cl ) :
+  center(c), radius(r), weight_cutoff(wc), weight_survival(ws), cells(cl) {
+  ncreated = 0; nrouletted = 0; nkilled = 0;
+}
+
+double dxtran_sphere::entryDistance( ray r ) {
+  point  d  = point( center.x - r.pos.x, center.y - r.pos.y, center.z - r.pos.z );
+  double c  = d.x * d.x + d.y * d.y + d.z * d.z - radius * radius;
+  double b  = d.x * r.dir.x + d.y * r.dir.y + d.z * r.dir.z;
+  double disc = b * b - c;
+  if ( c <= 0.0 || b <= 0.0 || disc < 0.0 ) { return std::numeric_limits<double>::max(); }
+  return b - std::sqrt( disc );
+}
+
+void dxtran_sphere::collide( particle* p, std::stack< particle >* bank ) {
+  std::shared_ptr< material > M = p->cellPointer()->getMaterial();
+  if ( ! M ) { return; }
+  point  r  = point( center.x - p->pos().x, center.y - p->pos().y, center.z - p->pos().z );
+  double L2 = r.x * r.x + r.y * r.y + r.z * r.z;
+  if ( L2 <= radius * radius ) { return; }           // collisions inside the sphere are left alone
+
+  // sample a direction uniformly within the cone subtended by the sphere
+  double cos_max = std::sqrt( 1.0 - radius * radius / L2 );
+  particle q( p->pos(), r );
+  q.scatter( 1.0 - Urand() * ( 1.0 - cos_max ) );
+  point  u  = q.dir();
+
+  // entry point on the sphere
+  double b  = u.x * r.x + u.y * r.y + u.z * r.z;
+  double d  = b - std::sqrt( std::fmax( 0.0, b * b - ( L2 - radius * radius ) ) );
+  point  entry = point( p->pos().x + d * u.x, p->pos().y + d * u.y, p->pos().z + d * u.z );
+  // the pseudo-particle leaves in a group and energy drawn from the emission density along u,
+  // which set the attenuation on the way
+  double mu  = p->dir().x * u.x + p->dir().y * u.y + p->dir().z * u.z;
+  particle s = *p;
+  M->sample_emission( mu, &s );
+  particle at = s;
+  double tau = opticalDepth( &s, entry, *cells, &at );
+  if ( tau == std::numeric_limits<double>::infinity() ) { return; }
+
+  // weight is the emission density over the cone sampling density, times the attenuation
+  double w  = p->wgt() * M->emission_density( mu, p ) * 2.0 * std::acos(-1.0) * ( 1.0 - cos_max ) * std::exp( -tau );
+  if ( w <= 0.0 ) { return; }
+  ncreated++;
+  if ( w < weight_cutoff ) {
+    nrouletted++;
+    if ( Urand() < w / weight_survival ) { w = weight_survival; }
+    else { return; }
+  }
+
+  // start on the sphere, and on a cell boundary coinciding with it on the inner side, as if it had just crossed it
+  particle t( at.pos(), u );
+  if ( at.onSurface() ) { t.setSurface( at.onSurface(), at.surfaceSense(), at.surfaceOffset() ); }
+  t.adjustWeight( w );
+  t.setGroup( s.group() );
+  t.setEnergy( s.energy() );
+  t.setCollisions( p->collisions() + 1 );   // the pseudo-particle carries on the history of the colliding one
+  t.setBirthCell( p->birthCell() );
+  bank->push( t );
+}
+
+void dxtran_sphere::report() {
+  std::cout << " dxtran: " << ncreated << " pseudo-particles, " << nrouletted << " rouletted, "
+            << nkilled << " collided particles killed at the sphere" << std::endl;
+}
@@ -0,0 +1,33 @@
+#ifndef _DXTRAN_HEADER_
+#define _DXTRAN_HEADER_
+
+#include <vector>
+#include <stack>
+#include <memory>
+
+#include "Point.h"
+#include "Particle.h"
+#include "Cell.h"
+
+// DXTRAN sphere: every collision outside the sphere banks a pseudo-particle on the sphere surface,
+// carrying the weight that would reach the sphere uncollided in its direction; collided particles
+// reaching the sphere are killed since the pseudo-particles already account for them
+class dxtran_sphere {
+  private:
+    point  center;                                 // center of the sphere
+    double radius;                                 // radius of the sphere
+    double weight_cutoff;                          // roulette pseudo-particles below this weight (0 = off, which can grow without bound)
+    double weight_survival;                        // weight given to roulette survivors
+    std::shared_ptr< cell_group > cells;           // cells of the outermost universe, for ray tracing the optical depth
+    unsigned long long ncreated, nrouletted, nkilled; // statistics
+  public:
+     dxtran_sphere( point c, double r, double wc, double ws, std::shared_ptr< cell_group > cl );
+    ~dxtran_sphere() {};
+
+    double entryDistance( ray r );                           // distance along r into the sphere, huge if it misses or starts inside
+    void   collide( particle* p, std::stack< particle >* bank ); // bank a pseudo-particle for the collision p is about to make
+    void   enter( particle* p ) { p->kill(); nkilled++; };   // collided particle reached the sphere
+    void   report();                                         // print pseudo-particle statistics
+};
+
+#endif
@@ -0,0 +1,134 @@
+#include <iostream>
+#include <cmath>
+#include <algorithm>
+
+#include "Random.h"
+#include "Cell.h"
+#include "Material.h"
+#include "Eigenvalue.h"
+
+power_iteration::power_iteration( int ninactive, int nactive, unsigned long long n, double k0 ) :
+  inactive(ninactive), active(nactive), nsources(n), k_bank(k0) {
+  cycle = 0; track_valid = true;
+  mnx = 0; mny = 0; mnz = 0; entropy = 0.0;
+  isotropic = std::make_shared< isotropicDirection_distribution > ( "isotropic" );
+  for ( int e = 0 ; e < 3 ; e++ ) { k_sum[e] = 0.0; k_squared[e] = 0.0; }
+}
+
+void power_iteration::beginCycle() {
+  history_sites.assign( nsources, std::vector< particle > () );
+  source_weight = 0.0;
+  k_collision = 0.0; k_absorption = 0.0; k_track = 0.0;
+  absorbed_ratio = 0.0;
+}
+
+// collision estimate of k, and the sites of the next generation from the expected number of fission neutrons
+void power_iteration::collide( particle* p, unsigned long long h ) {
+  std::shared_ptr< material > M = p->cellPointer()->getMaterial();
+  absorbed_ratio = 0.0;
+  if ( ! M ) { return; }
+  double nu_xs = M->nu_fission_xs( p );
+  if ( nu_xs <= 0.0 ) { return; }
+  absorbed_ratio = nu_xs / M->absorption_xs( p );
+  double yield   = p->wgt() * nu_xs / M->macro_xs( p );
+  k_collision += yield;
+
+  int n = (int) std::floor( yield / k_bank + Urand() );
+  for ( int i = 0 ; i < n ; i++ ) {
+    particle q( p->pos(), isotropic->sample() );
+    q.recordCell( p->cellPointer() );
+    M->sample_fission( p, &q );
+    history_sites[h].push_back( q );
+  }
+}
+
+void power_iteration::track( particle* p, double s ) {
+  if ( ! track_valid ) { return; }
+  std::shared_ptr< material > M = p->cellPointer()->getMaterial();
+  if ( M ) { k_track += p->wgt() * s * M->nu_fission_xs( p ); }
+}
+
+void power_iteration::endCycle( unsigned long long seed ) {
+  // exclusive prefix sum of the bank sizes gives where each history's sites go in the merged bank,
+  // so the merged order does not depend on the order the histories ran in
+  std::vector< unsigned long long > site_offset( nsources + 1, 0 );
+  for ( unsigned long long h = 0 ; h < nsources ; h++ ) { site_offset[h+1] = site_offset[h] + history_sites[h].size(); }
+  unsigned long long M = site_offset[ nsources ];
+  if ( M == 0 ) {
+    std::cout << " no fission sites were banked in cycle " << cycle + 1 << std::endl;
+    throw;
+  }
+  std::vector< particle > bank;
+  bank.reserve( M );
+  for ( unsigned long long h = 0 ; h < nsources ; h++ ) {
+    bank.insert( bank.begin() + site_offset[h], history_sites[h].begin(), history_sites[h].end() );
+  }
+  history_sites.clear();
+
+  // Shannon entropy of the sites, on a mesh bounding the first bank unless one was given
+  if ( mnx == 0 ) {
+    mesh_lo = bank[0].pos(); mesh_hi = bank[0].pos();
+    for ( auto& s : bank ) {
+      point x = s.pos();
+      mesh_lo = point( std::fmin( mesh_lo.x, x.x ), std::fmin( mesh_lo.y, x.y ), std::fmin( mesh_lo.z, x.z ) );
+      mesh_hi = point( std::fmax( mesh_hi.x, x.x ), std::fmax( mesh_hi.y, x.y ), std::fmax( mesh_hi.z, x.z ) );
+    }
+    mnx = std::max( 1, (int) std::ceil( std::cbrt( nsources / 20.0 ) ) );
+    mny = mnx; mnz = mnx;
+  }
+  std::vector< double > count( mnx * mny * mnz, 0.0 );
+  double inside = 0.0;
+  // voxel along one axis, -1 outside the mesh; sites on the upper face go to the last voxel, and along
+  // an axis where the mesh is flat, as the bounding box of a planar bank is, all go to the one voxel
+  auto bin = []( double x, double lo, double hi, int n ) {
+    if ( ! ( x >= lo && x <= hi ) ) { return -1; }
+    if ( ! ( hi > lo ) ) { return 0; }
+    return std::min( n - 1, (int) std::floor( ( x - lo ) / ( hi - lo ) * n ) );
+  };
+  for ( auto& s : bank ) {
+    point x = s.pos();
+    int i = bin( x.x, mesh_lo.x, mesh_hi.x, mnx );
+    int j = bin( x.y, mesh_lo.y, mesh_hi.y, mny );
+    int k = bin( x.z, mesh_lo.z, mesh_hi.z, mnz );
+    if ( i < 0 || j < 0 || k < 0 ) { continue; }
+    count[ i + mnx * ( j + mny * k ) ] += 1.0;
+    inside += 1.0;
+  }
+  entropy = 0.0;
+  for ( auto c : count ) {
+    if ( c > 0.0 ) { entropy -= c / inside * std::log2( c / inside ); }
+  }
+
+  // k estimates of the cycle, per unit source weight
+  double k[3] = { k_collision / source_weight, k_absorption / source_weight, k_track / source_weight };
+  std::cout << "  cycle " << cycle + 1 << ( activeCycle() ? "   " : " * " ) << "k collision " << k[0]
+            << "   absorption " << k[1];
+  if ( track_valid ) { std::cout << "   track length " << k[2]; }
+  std::cout << "   entropy " << entropy << "   sites " << M << std::endl;
+  if ( activeCycle() ) {
+    for ( int e = 0 ; e < 3 ; e++ ) { k_sum[e] += k[e]; k_squared[e] += k[e] * k[e]; }
+  }
+  k_bank = k[0];
+
+  // systematic sampling of the next sources, with one random offset for the whole cycle
+  RN_init_particle( &seed );
+  double U = Urand();
+  sources.clear();
+  sources.reserve( nsources );
+  for ( unsigned long long i = 0 ; i < nsources ; i++ ) {
+    sources.push_back( bank[ std::min( M - 1, (unsigned long long) ( ( i + U ) * M / nsources ) ) ] );
+  }
+  cycle++;
+}
+
+void power_iteration::report() {
+  std::cout << " k eigenvalue over " << active << " active cycles, " << inactive << " inactive" << std::endl;
+  const char* names[3] = { "collision", "absorption", "track length" };
+  for ( int e = 0 ; e < 3 ; e++ ) {
+    if ( e == 2 && ! track_valid ) { continue; }
+    double mean = k_sum[e] / active;
+    double var  = active > 1 ? ( k_squared[e] / active - mean * mean ) / ( active - 1 ) : 0.0;
+    std::cout << " k " << names[e] << "   " << mean << "   " << std::sqrt( std::fmax( 0.0, var ) ) << std::endl;
+  }
+  std::cout << " final Shannon entropy " << entropy << std::endl;
+}
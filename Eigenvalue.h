@@ -0,0 +1,71 @@
+#ifndef _EIGENVALUE_HEADER_
+#define _EIGENVALUE_HEADER_
+
+#include <vector>
+#include <memory>
+
+#include "Point.h"
+#include "Particle.h"
+#include "Distribution.h"
+#include "Estimator.h"
+
+// power iteration for the k eigenvalue: the histories of a cycle start from the fission bank of the previous one,
+// each collision banking w nu xs_f / ( xs_t k ) sites on average while fission itself only absorbs the particle
+// sites go to a buffer of the history that banked them, so histories could run in any order or on any thread:
+// a prefix sum over the buffer sizes places each buffer in the merged bank, and the next cycle's sources are
+// picked from it by systematic sampling, source i taking site ( i + U ) M / N, which needs no other communication
+class power_iteration {
+  private:
+    int    inactive, active;                          // number of cycles discarded and kept
+    int    cycle;                                     // current cycle, from 0
+    unsigned long long nsources;                      // histories per cycle
+    double k_bank;                                    // k the sites are banked with, the last cycle's collision estimate
+    std::vector< std::vector< particle > > history_sites; // sites banked by each history of the cycle
+    std::vector< particle > sources;                  // sources of the cycle (empty for the first one)
+    std::shared_ptr< distribution<point> > isotropic; // directions of fission neutrons
+    double source_weight;                             // weight the histories of the cycle started with
+    double k_collision, k_absorption, k_track;        // scores of the cycle
+    double absorbed_ratio;                            // nu xs_f / xs_a at the collision being sampled
+    bool   track_valid;                               // false under delta tracking, which skips the flights
+    double k_sum[3], k_squared[3];                    // sums over the active cycles
+    point  mesh_lo, mesh_hi;                          // entropy mesh, bounding the first bank if not given
+    int    mnx, mny, mnz;                             // entropy mesh voxels along each axis (0 = not set yet)
+    double entropy;                                   // Shannon entropy of the last bank
+  public:
+     power_iteration( int ninactive, int nactive, unsigned long long n, double k0 );
+    ~power_iteration() {};
+
+    void setEntropyMesh( point lo, point hi, int nx, int ny, int nz ) { // mesh the Shannon entropy is computed on
+      mesh_lo = lo; mesh_hi = hi; mnx = nx; mny = ny; mnz = nz;
+    };
+    void disableTrackEstimator() { track_valid = false; };             // flights are not followed under delta tracking
+    int  numCycles() { return inactive + active; };
+    bool activeCycle() { return cycle >= inactive; };                  // true if estimators keep the scores of this cycle
+    void beginCycle();                                                 // clear the banks and scores of a new cycle
+    bool hasSources() { return ! sources.empty(); };                   // false in the first cycle, started from the source
+    particle source( unsigned long long h ) { return sources[h]; };    // source of history h
+    void startHistory( double w ) { source_weight += w; };             // a history started with weight w
+    void collide( particle* p, unsigned long long h );                 // bank sites and score k at a collision of history h
+    void absorb( double w ) { k_absorption += w * absorbed_ratio; };   // weight w was absorbed by that collision
+    void track( particle* p, double s );                               // score k along a weight integrated track of length s
+    void endCycle( unsigned long long seed );                          // merge the banks, resample the sources and report
+    void report();                                                     // print the active cycle averages of k
+};
+
+// the track length estimate of k, attached to the cells so it sees each flight with the weight integrated
+// along it, as the exponential transform leaves it, like any other track length estimator
+class k_track_estimator : public estimator {
+  private:
+    power_iteration* eig;
+  public:
+     k_track_estimator( power_iteration* e ) : estimator("k track length"), eig(e) {};
+    ~k_track_estimator() {};
+
+    void score( particle* ) {};
+    void scoreTrack( particle* p, double s ) { eig->track( p, s ); };
+    void endHistory() {};                                              // k is summed by cycle, not by history
+    void discardHistory() {};
+    void report() {};                                                  // reported with the other k estimates
+};
+
+#endif
@@ -0,0 +1,31 @@
+#include <cmath>
+#include <algorithm>
+
+#include "EnergyGrid.h"
+
+energy_hash::energy_hash( const std::vector< double >& grid, int bins ) {
+  lnmin     = std::log( grid.front() );
+  inv_width = bins / ( std::log( grid.back() ) - lnmin );
+  int n = grid.size();
+  for ( int b = 0 ; b <= bins ; b++ ) {
+    double e = std::exp( lnmin + b / inv_width );
+    int    i = std::upper_bound( grid.begin(), grid.end(), e ) - grid.begin() - 1;
+    first.push_back( std::max( 0, std::min( i, n - 2 ) ) );
+  }
+}
+
+int energy_hash::index( double E, const std::vector< double >& grid ) {
+  int n = grid.size();
+  if ( E <= grid.front() ) { return 0; }
+  if ( E >= grid.back() )  { return n - 2; }
+  int b = std::min( (int) first.size() - 2, std::max( 0, (int) ( ( std::log( E ) - lnmin ) * inv_width ) ) );
+
+  // the interval lies between those of the bin edges, widened by one for roundoff in the edges
+  int lo = std::max( 0, first[b] - 1 ), hi = std::min( n - 2, first[b+1] + 1 );
+  return std::upper_bound( grid.begin() + lo + 1, grid.begin() + hi + 1, E ) - grid.begin() - 1;
+}
+
+energy_index energy_hash::at( int i, double E, const std::vector< double >& grid ) {
+  double f = ( E - grid[i] ) / ( grid[i+1] - grid[i] );
+  return energy_index( i, std::min( 1.0, std::max( 0.0, f ) ) );
+}
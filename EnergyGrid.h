@@ -0,0 +1,40 @@
+#ifndef _ENERGYGRID_HEADER_
+#define _ENERGYGRID_HEADER_
+
+#include <vector>
+
+// position of an energy on a grid: the point at or below it and the fraction of the way to the next
+// point, for lin-lin interpolation; a multigroup lookup is the group with fraction 0
+class energy_index {
+  public:
+    int    i;
+    double f;
+
+    energy_index( int index = 0, double frac = 0.0 ) : i(index), f(frac) {};
+    ~energy_index() {};
+
+    double interpolate( const std::vector< double >& v ) {       // value of a table on the grid at this position
+      return f == 0.0 ? v[i] : v[i] + f * ( v[i+1] - v[i] );
+    };
+};
+
+// logarithmic hash into an ascending energy grid: the grid interval of an energy is found from the bin of
+// its logarithm, which holds the few grid points that fall into it, instead of a search over the whole grid
+class energy_hash {
+  private:
+    double lnmin;               // log of the lowest grid energy
+    double inv_width;           // bins per unit of log energy
+    std::vector< int > first;   // grid interval containing the lower edge of each bin, and one past the last
+  public:
+     energy_hash() { lnmin = 0.0; inv_width = 0.0; };
+     energy_hash( const std::vector< double >& grid, int bins );
+    ~energy_hash() {};
+
+    int index( double E, const std::vector< double >& grid );      // interval i with grid[i] <= E < grid[i+1], clamped to the grid
+    energy_index locate( double E, const std::vector< double >& grid ) { // interval and interpolation fraction
+      return at( index( E, grid ), E, grid );
+    };
+    static energy_index at( int i, double E, const std::vector< double >& grid ); // fraction of E in interval i
+};
+
+#endif
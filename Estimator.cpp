@@ -1,22 +1,182 @@
 #include <cmath>
 #include <iostream>
+#include <limits>
+#include <fstream>
+#include <algorithm>
+#include <cstdint>
 
 #include "Estimator.h"
 #include "Material.h"
 #include "Particle.h"
 #include "Cell.h"
+#include "Source.h"
 
 void surface_current_estimator::score( particle* p ) { tally_hist += p->wgt(); }
 
-void track_length_estimator::score( particle* p ) {
-  // instead of scoring a weighted binary value, score a weighted track length divided by volume of cell*
-  // dividing by volume of cell is nonsensical for problem 5, so I'll assume you don't actually want flux
-  point reverse = point( -1.0 * p->dir().x, -1.0 * p->dir().y, -1.0 * p->dir().z ); // direction opposite particle path
-  std::pair< std::shared_ptr< surface >, double > S = p->cellPointer()->surfaceIntersect( ray(p->pos(), reverse ) );
-  tally_hist += p->wgt() * S.second; // for flux, would divide by cell volume here
+void counting_estimator::score( particle* p ) { count_hist++; }
+
+double point_detector_estimator::attenuation( particle* p, point& u, material* M ) {
+  point  r  = point( detector.x - p->pos().x, detector.y - p->pos().y, detector.z - p->pos().z );
+  double R2 = r.x * r.x + r.y * r.y + r.z * r.z;
+  if ( R2 == 0.0 && exclusion_radius == 0.0 ) { return 0.0; }     // direction to the detector is undefined
+  // on the detector itself every direction reaches it, so take the particle's own rather than normalizing a zero vector
+  u = R2 > 0.0 ? r : p->dir();
+  u.normalize();
+  // after a collision the group and energy heading for the detector are drawn from the emission density along u
+  particle q = *p;
+  if ( M ) { M->sample_emission( p->dir().x * u.x + p->dir().y * u.y + p->dir().z * u.z, &q ); }
+  double tau = opticalDepth( &q, detector, *cells );
+  if ( tau == std::numeric_limits<double>::infinity() ) { return 0.0; }
+  return std::exp( -tau ) / std::fmax( R2, exclusion_radius * exclusion_radius );
 }
 
-void counting_estimator::score( particle* p ) { count_hist++; }
+void point_detector_estimator::scoreSource( particle* p, std::shared_ptr< source > S ) {
+  point  u;
+  double a = attenuation( p, u );
+  if ( a > 0.0 ) { tally_hist += S->emissionWeight() * S->directionPdf( u ) * a; } // direction biasing does not apply
+}
+
+void point_detector_estimator::scoreCollision( particle* p ) {
+  std::shared_ptr< material > M = p->cellPointer()->getMaterial();
+  if ( ! M ) { return; }
+  point  u;
+  double a = attenuation( p, u, M.get() );
+  if ( a > 0.0 ) {
+    double mu = p->dir().x * u.x + p->dir().y * u.y + p->dir().z * u.z;
+    tally_hist += p->wgt() * M->emission_density( mu, p ) * a;
+  }
+}
+
+mesh_track_length_estimator::mesh_track_length_estimator( std::string label, point l, point h, int n1, int n2, int n3, std::string out,
+                                                          std::string storage, bool bin ) :
+  estimator(label), lo(l), hi(h), nx(n1), ny(n2), nz(n3), mesh( l, h, n1, n2, n3 ), output(out), binary(bin),
+  history_map(1, 4), sum_map(2, 4) {
+  nvoxels = (long long) nx * ny * nz;
+  nhist = 0; total_hist = 0.0; total_sum = 0.0; total_squared = 0.0;
+  // meshes up to a million voxels are small enough to start dense
+  dense = storage == "dense" || ( storage == "auto" && nvoxels <= 1000000 );
+  if ( dense ) { makeDense(); }
+  peak_bytes = bytes();
+}
+
+void mesh_track_length_estimator::makeDense() {
+  hist.assign( nvoxels, 0.0 );
+  sum.assign( nvoxels, 0.0 );
+  sum_squared.assign( nvoxels, 0.0 );
+  for ( unsigned long long i = 0 ; i < sum_map.size() ; i++ ) {
+    sum[ sum_map.key(i) ]         = sum_map.at(i)[0];
+    sum_squared[ sum_map.key(i) ] = sum_map.at(i)[1];
+  }
+  history_map = voxel_map( 1, 1 );
+  sum_map     = voxel_map( 2, 1 );
+  dense = true;
+}
+
+unsigned long long mesh_track_length_estimator::bytes() {
+  return ( hist.capacity() + sum.capacity() + sum_squared.capacity() ) * sizeof( double )
+       + touched.capacity() * sizeof( long long ) + history_map.bytes() + sum_map.bytes();
+}
+
+void mesh_track_length_estimator::scoreFlight( particle* p, double s, double decay ) {
+  double wgt = p->wgt();
+  mesh.walk( p->pos(), p->dir(), s, decay, [this,wgt]( long long v, double x ) { add( v, wgt * x ); } );
+}
+
+void mesh_track_length_estimator::endHistory() {
+  if ( ! dense ) {
+    for ( unsigned long long i = 0 ; i < history_map.size() ; i++ ) {
+      double  h = history_map.at(i)[0];
+      double* x = sum_map.insert( history_map.key(i) );
+      x[0] += h;
+      x[1] += h * h;
+    }
+    history_map.clear();
+    // once most voxels have been reached the flat arrays take less memory
+    peak_bytes = std::max( peak_bytes, bytes() );
+    if ( sum_map.bytes() > 3 * nvoxels * sizeof( double ) ) { makeDense(); }
+  }
+  for ( auto v : touched ) {
+    sum[v]         += hist[v];
+    sum_squared[v] += hist[v] * hist[v];
+    hist[v] = 0.0;
+  }
+  touched.clear();
+  total_sum     += total_hist;
+  total_squared += total_hist * total_hist;
+  total_hist = 0.0;
+  nhist++;
+}
+
+void mesh_track_length_estimator::discardHistory() {
+  history_map.clear();
+  for ( auto v : touched ) { hist[v] = 0.0; }
+  touched.clear();
+  total_hist = 0.0;
+}
+
+void mesh_track_length_estimator::report() {
+  // a mesh nothing reached has no relative error, printed as 0 like its voxels
+  double mean = total_sum / nhist;
+  double var  = ( total_squared / nhist - mean * mean ) / nhist;
+  double rel  = mean > 0.0 ? std::sqrt( std::fmax( 0.0, var ) ) / mean : 0.0;
+  std::cout << " " << name() << "   " << mean << "   " << rel;
+  if ( run_time > 0.0 && rel > 0.0 ) { std::cout << "   FOM = " << 1.0 / ( rel * rel * run_time ); }
+  std::cout << std::endl;
+  peak_bytes = std::max( peak_bytes, bytes() );
+  std::cout << "   " << ( dense ? "dense" : "sparse" ) << " storage of " << nvoxels << " voxels";
+  if ( ! dense ) { std::cout << ", " << sum_map.size() << " reached"; }
+  std::cout << ", peak memory " << peak_bytes / 1048576.0 << " MB" << std::endl;
+  if ( binary ) { writeBinary(); return; }
+
+  // mean track length and relative error of every voxel, x varying fastest; sparse sums are looked up
+  // voxel by voxel, those never reached printing as zero, so the flat arrays are never built for the report
+  std::ofstream out( output );
+  out << "# " << name() << " mesh " << nx << " " << ny << " " << nz << " from " << lo.x << " " << lo.y << " " << lo.z
+      << " to " << hi.x << " " << hi.y << " " << hi.z << ", " << nhist << " histories" << std::endl;
+  out << "# i j k track_length relative_error" << std::endl;
+  for ( long long v = 0 ; v < nvoxels ; v++ ) {
+    double  s[2] = { 0.0, 0.0 };
+    double* x    = dense ? nullptr : sum_map.find( v );
+    if ( dense ) { s[0] = sum[v]; s[1] = sum_squared[v]; }
+    else if ( x ) { s[0] = x[0]; s[1] = x[1]; }
+    double m = s[0] / nhist;
+    double r = m > 0.0 ? std::sqrt( std::fmax( 0.0, ( s[1] / nhist - m * m ) / nhist ) ) / m : 0.0;
+    out << v % nx << " " << ( v / nx ) % ny << " " << v / ( (long long) nx * ny ) << " " << m << " " << r << std::endl;
+  }
+  std::cout << "   voxels written to " << output << std::endl;
+}
+
+// header: "MESHTAL1", nx, ny, nz as int32, the lower and upper corners as 3 doubles each, the number of histories
+// and of voxels written as uint64; then for each voxel scored its index (x fastest) as uint64 and the sums of the
+// history scores and of their squares as doubles, which lets runs be combined before taking means and errors
+void mesh_track_length_estimator::writeBinary() {
+  std::ofstream out( output, std::ios::binary );
+  unsigned long long count = 0;
+  if ( dense ) { for ( auto x : sum ) { if ( x != 0.0 ) { count++; } } }
+  else { count = sum_map.size(); }
+  int32_t n[3] = { nx, ny, nz };
+  double  c[6] = { lo.x, lo.y, lo.z, hi.x, hi.y, hi.z };
+  unsigned long long h = nhist;
+  out.write( "MESHTAL1", 8 );
+  out.write( (const char*) n, sizeof( n ) );
+  out.write( (const char*) c, sizeof( c ) );
+  out.write( (const char*) &h, sizeof( h ) );
+  out.write( (const char*) &count, sizeof( count ) );
+
+  // voxels are streamed one record at a time, in index order for dense storage and first reached for sparse
+  auto record = [&out]( unsigned long long v, double s, double s2 ) {
+    out.write( (const char*) &v, sizeof( v ) );
+    out.write( (const char*) &s, sizeof( s ) );
+    out.write( (const char*) &s2, sizeof( s2 ) );
+  };
+  if ( dense ) {
+    for ( long long v = 0 ; v < nvoxels ; v++ ) { if ( sum[v] != 0.0 ) { record( v, sum[v], sum_squared[v] ); } }
+  }
+  else {
+    for ( unsigned long long i = 0 ; i < sum_map.size() ; i++ ) { record( sum_map.key(i), sum_map.at(i)[0], sum_map.at(i)[1] ); }
+  }
+  std::cout << "   " << count << " voxels written to " << output << std::endl;
+}
 
 void counting_estimator::endHistory() {
   if ( tally.size() < count_hist + 1 ) { tally.resize( count_hist + 1, 0.0 ); }
@@ -38,8 +198,8 @@ void counting_estimator::report() {
   std::cout << "   var  = " << s2 - s1*s1 << std::endl;
 }
 
-void track_estimator::score( particle* p ) { ntracks ++; }
-void track_estimator::endHistory() {  }
+void track_estimator::score( particle* p ) { ntracks_hist++; }
+void track_estimator::endHistory() { ntracks += ntracks_hist; ntracks_hist = 0; }
 void track_estimator::report() { 
   std::cout << " " << name() << "   " << ntracks << std::endl; 
 }
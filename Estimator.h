@@ -11,25 +11,43 @@
 #include "Particle.h"
 #include "Material.h"
 #include "Reaction.h"
+#include "VoxelMap.h"
+#include "Mesh.h"
 
 class surface;
+class cell;
+class cell_group;
+class source;
 
 class estimator {
   private:
     std::string estimator_name;
   protected:
     unsigned long long nhist;
+    double run_time;                                             // seconds spent in transport, for the figure of merit
   public:
-     estimator( std::string label ) : estimator_name(label) {};
+     estimator( std::string label ) : estimator_name(label) { run_time = 0.0; };
     ~estimator() {};
 
     virtual std::string name() final { return estimator_name; };
+    virtual void setRunTime( double t ) final { run_time = t; }; // set transport time before report
     virtual void score( particle* ) = 0;
     template< typename T >
     void score( particle*, T ) { assert(false); };
     void score( particle*, double, std::shared_ptr< material > ) {};
     virtual void endHistory()       = 0;
+    virtual void discardHistory()   = 0;                    // drop the scores of the current history, e.g. in inactive cycles
     virtual void report()           = 0;
+    virtual double historyScore() { return 0.0; };          // score of the current history so far
+    virtual double figureOfMerit() { return 0.0; };         // 1 / ( R^2 T ) after a run, zero if not defined
+    virtual void scoreTrack( particle* p, double ) { score( p ); };   // score a track, by default as one event whatever its length
+    virtual void scoreFlight( particle* p, double s, double decay ) { // score a flight of length s ending at p, along which the
+      if ( decay != 0.0 ) { s = -std::expm1( -decay * s ) / decay; }  // weight decays as exp( -decay x ), as the weight integrated
+      scoreTrack( p, s );                                             // track by default
+    };
+    virtual void scoreCrossing( particle* p, surface*, ray ) { score( p ); }; // score crossing a surface, given the position in its
+                                                                              // coordinates and direction, by default as an event
+    virtual void scoreCollision( particle* ) {};            // score a collision, before it is sampled; nothing by default
 };
 
 class single_valued_estimator : public estimator {
@@ -53,13 +71,27 @@ class single_valued_estimator : public estimator {
       tally_sum     += tally_hist;
       tally_squared += tally_hist * tally_hist;
       tally_hist = 0.0; }
+    virtual void discardHistory() final { tally_hist = 0.0; };
 
     virtual void score( particle* ) = 0;
 
+    double historyScore() { return tally_hist; };
+
+    double figureOfMerit() {
+      double mean = tally_sum / nhist;
+      double var  = ( tally_squared / nhist - mean*mean ) / nhist;
+      double rel  = std::sqrt( var ) / mean;
+      return ( run_time > 0.0 && rel > 0.0 ) ? 1.0 / ( rel * rel * run_time ) : 0.0;  // also zero without a score
+    };
+
     virtual void report() final {
       double mean = tally_sum / nhist;
       double var  = ( tally_squared / nhist - mean*mean ) / nhist;
-      std::cout << " " << name() << "   " << mean << "   " << std::sqrt( var ) / mean << std::endl;  
+      double rel  = std::sqrt( var ) / mean;
+      std::cout << " " << name() << "   " << mean << "   " << rel;
+      // figure of merit 1 / ( R^2 T ) to compare variance reduction settings
+      if ( run_time > 0.0 ) { std::cout << "   FOM = " << 1.0 / ( rel * rel * run_time ); }
+      std::cout << std::endl;
     };
 };
 
@@ -80,7 +112,71 @@ class track_length_estimator : public single_valued_estimator {
     track_length_estimator( std::string label ) : single_valued_estimator(label) {};
     ~track_length_estimator() {};
 
-    void score( particle* );
+    void score( particle* ) {};                                      // tracks are scored through scoreTrack, never as events
+    void scoreTrack( particle* p, double s ) { tally_hist += p->wgt() * s; };
+};
+
+// next-event estimator of the flux at a point: every source emission and collision scores the
+// expected weight per unit area arriving at the detector uncollided, w f(mu) exp( -tau ) / R^2,
+// with R^2 held at the exclusion radius squared for emissions closer than that
+class point_detector_estimator : public single_valued_estimator {
+  private:
+    point  detector;                                // detector location
+    double exclusion_radius;                        // bounds the 1 / R^2 singularity (0 = unbounded)
+    std::shared_ptr< cell_group > cells;            // cells of the outermost universe, for ray tracing the optical depth
+    double attenuation( particle* p, point& u, material* M = nullptr ); // exp( -tau ) / R^2 from p to the detector, u set to the
+                                                                        // direction, M the material if p is leaving a collision
+  public:
+    point_detector_estimator( std::string label, point d, double r0, std::shared_ptr< cell_group > c ) : 
+      single_valued_estimator(label), detector(d), exclusion_radius(r0), cells(c) {};
+    ~point_detector_estimator() {};
+
+    void score( particle* ) {};                                      // nothing is scored on surface or track events
+    void scoreSource( particle* p, std::shared_ptr< source > S );   // score the emission of a source particle
+    void scoreCollision( particle* p );                              // score a collision, called for the detectors from the main loop
+};
+
+// track length in each voxel of a regular Cartesian mesh: flights are walked voxel by voxel with the
+// Amanatides-Woo traversal, and the scores of a history are kept in a flat array next to the list of
+// voxels it reached, so closing out a history only touches those
+// meshes too large to store densely keep the history scores and the sums in hash maps holding only the voxels
+// reached so far, switching to the flat arrays once the maps would take more memory than those
+class mesh_track_length_estimator : public estimator {
+  private:
+    point  lo, hi;                          // corners of the mesh
+    int    nx, ny, nz;                      // number of voxels along each axis
+    cartesian_mesh mesh;                    // walks the flights
+    long long nvoxels;                      // nx * ny * nz
+    std::string output;                     // file the voxel results are written to
+    bool   binary;                          // write the scored voxels in binary instead of every voxel as text
+    bool   dense;                           // true once the flat arrays are in use
+    std::vector< double > hist, sum, sum_squared; // scores of the current history, and their sums over histories, x fastest
+    std::vector< long long > touched;       // voxels scored in the current history
+    voxel_map history_map;                  // sparse storage: scores of the current history
+    voxel_map sum_map;                      // sparse storage: sum and sum of squares of every voxel reached
+    unsigned long long peak_bytes;          // largest memory used for the voxels
+    double total_hist, total_sum, total_squared; // the same for the whole mesh
+    void add( long long v, double x ) {     // add x to voxel v in the current history
+      if ( ! dense ) { *history_map.insert( v ) += x; }
+      else {
+        if ( hist[v] == 0.0 ) { touched.push_back( v ); }
+        hist[v] += x;
+      }
+      total_hist += x;
+    };
+    void makeDense();                       // move the sums into flat arrays
+    unsigned long long bytes();             // memory used for the voxels
+    void writeBinary();                     // stream the scored voxels to the output file
+  public:
+     mesh_track_length_estimator( std::string label, point l, point h, int n1, int n2, int n3, std::string out,
+                                  std::string storage, bool bin );
+    ~mesh_track_length_estimator() {};
+
+    void score( particle* ) {};                                      // nothing is scored on surface events
+    void scoreFlight( particle* p, double s, double decay );
+    void endHistory();
+    void discardHistory();
+    void report();                                                   // print the mesh total and write the voxels to the output file
 };
 
 class counting_estimator : public estimator {
@@ -88,23 +184,25 @@ class counting_estimator : public estimator {
     int count_hist;
     std::vector< double > tally;
   public:
-     counting_estimator( std::string label ) : estimator(label) { count_hist = 0; };
+     counting_estimator( std::string label ) : estimator(label) { count_hist = 0; nhist = 0; };
     ~counting_estimator() {};
 
     void score( particle* );
     void endHistory();
+    void discardHistory() { count_hist = 0; };
     void report();
 };
 
 class track_estimator : public estimator {
   private:
-    unsigned long long ntracks;
+    unsigned long long ntracks, ntracks_hist;
   public:
-    track_estimator( std::string label ) : estimator(label) {};
+    track_estimator( std::string label ) : estimator(label) { ntracks = 0; ntracks_hist = 0; nhist = 0; };
     ~track_estimator() {};
 
     void score( particle* );
     void endHistory();
+    void discardHistory() { ntracks_hist = 0; };
     void report();
 };
 
@@ -0,0 +1,104 @@
+#include <iostream>
+#include <fstream>
+#include <algorithm>
+#include <limits>
+
+#include "Cell.h"
+#include "Generator.h"
+
+importance_generator::importance_generator( std::shared_ptr< estimator > E, std::shared_ptr< weight_window > W, 
+  int ncells, int iter, std::string out ) : target(E), mesh(W), iterations(iter), output(out) {
+  nregions = mesh ? mesh->size() : ncells;
+  future_score.resize( nregions, 0.0 );
+  entry_weight.resize( nregions, 0.0 );
+  current       = -1;
+  source_score  = 0.0;
+  source_weight = 0.0;
+  first         = true;
+}
+
+int importance_generator::region( particle* p ) {
+  if ( mesh ) { return mesh->index( p->pos() ); }
+  return p->cellPointer()->getIndex();
+}
+
+// credit the target score accumulated since each entry to its region
+void importance_generator::close( unsigned long long depth ) {
+  double score = target->historyScore();
+  while ( ! open.empty() && open.back().depth >= depth ) {
+    region_entry e = open.back();
+    if ( e.region < 0 ) { source_score += score - e.score; }
+    else { future_score[ e.region ] += score - e.score; }
+    open.pop_back();
+  }
+}
+
+void importance_generator::enter( int r, double w, unsigned long long depth ) {
+  current = r;
+  entry_weight[r] += w;
+  open.push_back( region_entry( r, w, target->historyScore(), depth ) );
+}
+
+void importance_generator::startParticle( particle* p, unsigned long long depth ) {
+  // progeny of entries made at this depth or deeper are all done once an older particle is taken
+  close( depth );
+  current = -1;
+  int r = region( p );
+  if ( first ) {
+    // the source particle is scored as a whole history to normalize importances
+    source_weight += p->wgt();
+    open.push_back( region_entry( -1, p->wgt(), 0.0, 0 ) );
+    first = false;
+  }
+  if ( r >= 0 ) { enter( r, p->wgt(), depth - 1 ); }
+}
+
+std::vector< double > importance_generator::importances() {
+  // the history entry (region -1) is still open at this point only if no history ran
+  double norm = source_weight > 0.0 ? source_score / source_weight : 0.0;
+  std::vector< double > imp( nregions, 0.0 );
+  double smallest = std::numeric_limits<double>::max();
+  for ( int i = 0 ; i < nregions ; i++ ) {
+    if ( entry_weight[i] > 0.0 && future_score[i] > 0.0 && norm > 0.0 ) {
+      imp[i]   = future_score[i] / entry_weight[i] / norm;
+      smallest = std::min( smallest, imp[i] );
+    }
+  }
+  // regions that were visited but never led to a score get the smallest importance found,
+  // regions never visited are left at zero so the caller can keep what it had
+  for ( int i = 0 ; i < nregions ; i++ ) {
+    if ( imp[i] == 0.0 && entry_weight[i] > 0.0 && smallest < std::numeric_limits<double>::max() ) { imp[i] = smallest; }
+  }
+  return imp;
+}
+
+// lower bounds put a unit weight source particle in the middle of its window
+std::vector< double > importance_generator::lowerBounds( std::vector< double > imp ) {
+  std::vector< double > lower( nregions, 0.0 );
+  for ( int i = 0 ; i < nregions ; i++ ) {
+    if ( imp[i] > 0.0 ) { lower[i] = 2.0 / ( ( 1.0 + mesh->upperRatio() ) * imp[i] ); }
+  }
+  return lower;
+}
+
+// write either cell importances or a weight window element that can be pasted into the input
+void importance_generator::write( std::vector< double > values, std::vector< std::string > cell_names ) {
+  std::ofstream out( output );
+  if ( ! out ) {
+    std::cout << " could not open " << output << " to write generated importances" << std::endl;
+    return;
+  }
+  out.precision( 6 );
+  if ( mesh ) {
+    std::vector< double > lower = lowerBounds( values );
+    out << "<weightWindow " << mesh->attributes() << ">" << std::endl;
+    for ( int i = 0 ; i < nregions ; i++ ) { out << " " << lower[i]; }
+    out << std::endl << "</weightWindow>" << std::endl;
+  }
+  else {
+    for ( int i = 0 ; i < nregions ; i++ ) {
+      out << "<cell name=\"" << cell_names[i] << "\" importance=\"" << values[i] << "\"/>" << std::endl;
+    }
+  }
+  std::cout << " generated importances written to " << output << std::endl;
+}
@@ -0,0 +1,62 @@
+#ifndef _GENERATOR_HEADER_
+#define _GENERATOR_HEADER_
+
+#include <string>
+#include <vector>
+#include <memory>
+
+#include "Particle.h"
+#include "Estimator.h"
+#include "WeightWindow.h"
+
+// records the region a particle entered, its weight, the target score at that time, and the bank
+// depth; everything scored until the bank drops below that depth belongs to the particle and its progeny
+class region_entry {
+  public:
+    int                region;
+    double             weight;
+    double             score;
+    unsigned long long depth;
+
+    region_entry( int r, double w, double s, unsigned long long d ) : region(r), weight(w), score(s), depth(d) {};
+    ~region_entry() {};
+};
+
+// forward importance generator: the importance of a region is the expected future score
+// of the target estimator per unit weight entering the region
+// regions are cells (by index), or voxels of the weight window mesh if one is given
+class importance_generator {
+  private:
+    std::shared_ptr< estimator >     target;        // estimator the importances are generated for
+    std::shared_ptr< weight_window > mesh;          // weight window mesh, null to generate cell importances
+    int                              nregions;      // number of cells or voxels
+    int                              iterations;    // number of forward runs
+    std::string                      output;        // file the generated importances are written to
+    std::vector< double >            future_score;  // sum of future scores per region
+    std::vector< double >            entry_weight;  // sum of entering weights per region
+    std::vector< region_entry >      open;          // entries whose progeny are still being transported
+    int                              current;       // region of the working particle
+    double                           source_score;  // sum of future scores of source particles
+    double                           source_weight; // sum of source particle weights
+    bool                             first;         // true until the first particle of a history has started
+    void close( unsigned long long depth );         // close entries with depth >= depth
+    void enter( int r, double w, unsigned long long depth ); // record an entry into region r
+    int  region( particle* p );                     // region of particle p
+  public:
+     importance_generator( std::shared_ptr< estimator > E, std::shared_ptr< weight_window > W, int ncells, int iter, std::string out );
+    ~importance_generator() {};
+
+    int  numIterations() { return iterations; };
+    double figureOfMerit() { return target->figureOfMerit(); };  // figure of merit of the target after a run
+    void startParticle( particle* p, unsigned long long depth ); // particle taken from bank, depth = bank size before pop
+    void event( particle* p, double w, unsigned long long depth ) { // after a crossing or collision, with weight
+      int r = region( p );                                          // and bank size from before the event
+      if ( r != current && r >= 0 ) { enter( r, w, depth ); }
+    };
+    void endHistory() { close( 0 ); first = true; };             // history done, close all entries
+    std::vector< double > importances();                         // importances normalized to the source particles
+    std::vector< double > lowerBounds( std::vector< double > imp ); // weight window lower bounds from importances
+    void write( std::vector< double > values, std::vector< std::string > cell_names ); // write input to output file
+};
+
+#endif
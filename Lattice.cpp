@@ -0,0 +1,90 @@
+#include <cmath>
+#include <limits>
+#include <algorithm>
+
+#include "Lattice.h"
+
+int rect_lattice::index( point p ) {
+  int i = std::min( nx - 1, std::max( 0, (int) std::floor( ( p.x - x0 ) / px ) ) );
+  int j = std::min( ny - 1, std::max( 0, (int) std::floor( ( p.y - y0 ) / py ) ) );
+  return i + nx * j;
+}
+
+double rect_lattice::distance( ray r, int e ) {
+  point  c    = center( e );
+  double dist = std::numeric_limits<double>::max();
+  // only faces ahead of the particle count, which also covers points beyond an edge element
+  if ( r.dir.x > 0.0 ) { double d = ( c.x + 0.5 * px - r.pos.x ) / r.dir.x; if ( d > 0.0 ) { dist = std::fmin( dist, d ); } }
+  if ( r.dir.x < 0.0 ) { double d = ( c.x - 0.5 * px - r.pos.x ) / r.dir.x; if ( d > 0.0 ) { dist = std::fmin( dist, d ); } }
+  if ( r.dir.y > 0.0 ) { double d = ( c.y + 0.5 * py - r.pos.y ) / r.dir.y; if ( d > 0.0 ) { dist = std::fmin( dist, d ); } }
+  if ( r.dir.y < 0.0 ) { double d = ( c.y - 0.5 * py - r.pos.y ) / r.dir.y; if ( d > 0.0 ) { dist = std::fmin( dist, d ); } }
+  return dist;
+}
+
+// distance to the nearest face of the element of the infinite grid containing p, whose faces
+// are the only places the clamped element can change
+double rect_lattice::safety( point p ) {
+  double fx = ( p.x - x0 ) / px - std::floor( ( p.x - x0 ) / px );
+  double fy = ( p.y - y0 ) / py - std::floor( ( p.y - y0 ) / py );
+  return std::fmin( std::fmin( fx, 1.0 - fx ) * px, std::fmin( fy, 1.0 - fy ) * py );
+}
+
+hex_lattice::hex_lattice( std::string label, double x, double y, double p, int m ) :
+  lattice(label), x0(x), y0(y), pitch(p), n(m) {
+  elements.resize( n * n );
+  row = 0.5 * std::sqrt( 3.0 ) * pitch;
+  probe = 1.0e-9 * pitch;
+  // faces lie across from the six neighbours
+  for ( int k = 0 ; k < 6 ; k++ ) {
+    double a = k * std::acos(-1.0) / 3.0;
+    normals[k] = point( std::cos( a ), std::sin( a ), 0.0 );
+  }
+}
+
+// convert to fractional axial coordinates and round to the nearest hexagon in cube coordinates,
+// the result is the hexagon of the infinite tiling containing p
+void hex_lattice::axial( point p, int& qi, int& ri ) {
+  double rf = ( p.y - y0 ) / row;
+  double qf = ( p.x - x0 ) / pitch - 0.5 * rf;
+  double sf = -qf - rf;
+  double q  = std::round( qf ), r = std::round( rf ), s = std::round( sf );
+  double dq = std::fabs( q - qf ), dr = std::fabs( r - rf ), ds = std::fabs( s - sf );
+  if ( dq > dr && dq > ds ) { q = -r - s; }
+  else if ( dr > ds )       { r = -q - s; }
+  qi = (int) q; ri = (int) r;
+}
+
+int hex_lattice::index( point p ) {
+  int q, r;
+  axial( p, q, r );
+  return std::min( n - 1, std::max( 0, q ) ) + n * std::min( n - 1, std::max( 0, r ) );
+}
+
+// the clamped regions beyond the edge are not bounded by the faces of their element, so the
+// faces used are those of the hexagon of the infinite tiling the particle moves in; crossing
+// one of them where the clamped element does not change only costs an extra boundary event
+double hex_lattice::distance( ray r, int ) {
+  int qi, ri;
+  axial( point( r.pos.x + probe * r.dir.x, r.pos.y + probe * r.dir.y, 0.0 ), qi, ri );
+  point  c( x0 + pitch * ( qi + 0.5 * ri ), y0 + row * ri, 0.0 );
+  double dist = std::numeric_limits<double>::max();
+  for ( int k = 0 ; k < 6 ; k++ ) {
+    double s = normals[k].x * r.dir.x + normals[k].y * r.dir.y;
+    if ( s <= 0.0 ) { continue; }
+    double d = ( 0.5 * pitch - normals[k].x * ( r.pos.x - c.x ) - normals[k].y * ( r.pos.y - c.y ) ) / s;
+    if ( d > 0.0 ) { dist = std::fmin( dist, d ); }
+  }
+  return dist;
+}
+
+// inscribed distance from p to the faces of the hexagon of the infinite tiling containing it
+double hex_lattice::safety( point p ) {
+  int qi, ri;
+  axial( p, qi, ri );
+  point  c( x0 + pitch * ( qi + 0.5 * ri ), y0 + row * ri, 0.0 );
+  double reach = 0.0;
+  for ( int k = 0 ; k < 6 ; k++ ) {
+    reach = std::fmax( reach, normals[k].x * ( p.x - c.x ) + normals[k].y * ( p.y - c.y ) );
+  }
+  return std::fmax( 0.0, 0.5 * pitch - reach );
+}
@@ -0,0 +1,94 @@
+#ifndef _LATTICE_HEADER_
+#define _LATTICE_HEADER_
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <cmath>
+
+#include "Point.h"
+#include "Cell.h"
+
+// a named set of cells that can fill cells of other universes or the elements of a lattice;
+// its surfaces are in coordinates local to wherever it is placed
+class universe {
+  private:
+    std::string universe_name;
+    std::vector< std::shared_ptr< cell > > universe_cells;
+    std::shared_ptr< cell_group > universe_group;  // built on first use, once all cells are added
+  public:
+     universe( std::string label ) : universe_name(label) {};
+    ~universe() {};
+
+    std::string name() { return universe_name; };
+    void addCell( std::shared_ptr< cell > C ) { universe_cells.push_back( C ); };
+    std::vector< std::shared_ptr< cell > >& cells() { return universe_cells; };
+    cell_group& group() {                                   // cells prepared for point location
+      if ( ! universe_group ) { universe_group = std::make_shared< cell_group > ( universe_cells ); }
+      return *universe_group;
+    };
+};
+
+// regular array of elements, each filled with a universe whose origin is the element center;
+// lattices are infinite along z and points beyond the edge belong to the nearest edge element
+class lattice {
+  private:
+    std::string lattice_name;
+  protected:
+    std::vector< std::shared_ptr< universe > > elements;  // universe in each element
+    double probe;                                         // small fraction of the pitch, resolves points on element faces
+  public:
+     lattice( std::string label ) : lattice_name(label) {};
+    virtual ~lattice() {};
+
+    virtual std::string name() final { return lattice_name; };
+    virtual int  size() final { return elements.size(); };
+    virtual void setElement( int e, std::shared_ptr< universe > U ) final { elements[e] = U; };
+    virtual std::shared_ptr< universe > element( int e ) final { return elements[e]; };
+    virtual int    index( point p )         = 0; // element containing p, in lattice coordinates
+    virtual int    index( ray r ) final {        // element r moves into, also from a point on a face
+      return index( point( r.pos.x + probe * r.dir.x, r.pos.y + probe * r.dir.y, r.pos.z + probe * r.dir.z ) );
+    };
+    virtual point  center( int e )          = 0; // center of element e, in lattice coordinates
+    virtual double distance( ray r, int e ) = 0; // distance along r (lattice coordinates) to the boundary of element e
+    virtual double safety( point p )        = 0; // lower bound on the distance from p to the boundary of its element
+};
+
+// nx by ny rectangular elements, x index varying fastest, lower left corner at (x0,y0)
+class rect_lattice : public lattice {
+  private:
+    double x0, y0, px, py;
+    int    nx, ny;
+  public:
+     rect_lattice( std::string label, double x, double y, double dx, double dy, int n1, int n2 ) :
+       lattice(label), x0(x), y0(y), px(dx), py(dy), nx(n1), ny(n2) {
+       elements.resize( nx * ny ); probe = 1.0e-9 * std::fmin( px, py );
+     };
+    ~rect_lattice() {};
+
+    int    index( point p );
+    point  center( int e ) { return point( x0 + ( e % nx + 0.5 ) * px, y0 + ( e / nx + 0.5 ) * py, 0.0 ); };
+    double distance( ray r, int e );
+    double safety( point p );
+};
+
+// n by n pointy topped hexagons, pitch across flats, in axial coordinates (q,r):
+// element (q,r) is centered at (x0,y0) + q (pitch,0) + r (pitch/2, pitch sqrt(3)/2), q varying fastest
+class hex_lattice : public lattice {
+  private:
+    double x0, y0, pitch;
+    int    n;
+    double row;                  // distance between rows, pitch sqrt(3)/2
+    point  normals[6];           // outward normals of the six faces
+    void   axial( point p, int& q, int& r ); // unclamped axial coordinates of the hexagon containing p
+  public:
+     hex_lattice( std::string label, double x, double y, double p, int m );
+    ~hex_lattice() {};
+
+    int    index( point p );
+    point  center( int e ) { return point( x0 + pitch * ( e % n + 0.5 * ( e / n ) ), y0 + row * ( e / n ), 0.0 ); };
+    double distance( ray r, int e );
+    double safety( point p );
+};
+
+#endif
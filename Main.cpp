@@ -19,15 +19,153 @@
 #include "Cell.h"
 #include "Simulation.h"
 
-int main() {
+// transport the particles of one history, h being its index within the cycle of an eigenvalue problem
+void transportHistory( simulation& sim, std::stack< particle >& bank, unsigned long long nps, unsigned long long h ) {
+  perf_counters*    pc   = sim.counters.get(); // hardware counters, null unless requested in the input
+  history_profiler* prof = sim.profiler.get(); // per history profiler, null unless requested in the input
+  importance_generator* gen = sim.generator.get(); // importance generator, null unless requested in the input
+  dxtran_sphere*        dx  = sim.dxtran.get();    // DXTRAN sphere, null unless requested in the input
+  population_control*   popc = sim.population.get(); // bank size control, null unless requested in the input
+  power_iteration*      eig = sim.eigenvalue.get(); // power iteration, null for fixed source problems
+  if ( prof ) { prof->beginHistory( nps ); }
+  bool source_particle = true;
 
-  // user enters the XML file name
-  std::string input_file_name;
-  std::cout << " Enter XML input file name: " << std::endl;
-  std::cin >> input_file_name;
+  // loop for a single history
+  while ( ! bank.empty() ) {
 
-  // load and initialize problem
-  simulation sim( input_file_name );
+    // take a particle from the bank
+    particle p = bank.top();
+    if ( pc ) { pc->begin( residency_phase ); }
+    sim.findResidency( &p ); //determine and assign p_cell
+    if ( pc ) { pc->end( residency_phase ); }
+    if ( ! p.alive() ) { bank.pop(); source_particle = false; continue; } // lost, outside all cells
+    if ( ! p.birthCell() ) { p.setBirthCell( p.cellPointer().get() ); }   // sources and secondaries are born where they start
+    if ( source_particle ) {
+      // point detectors score the source emission once its cell is known
+      for ( auto d : sim.detectors ) { d->scoreSource( &p, sim.src ); }
+      source_particle = false;
+    }
+    if ( gen ) { gen->startParticle( &p, bank.size() ); }
+    bank.pop();
+
+    while ( p.alive() ) { // particle loop
+
+      // determine its next action, either media interaction or boundary crossing
+      if ( prof ) { prof->countTrack(); }
+      std::pair< std::shared_ptr< surface >, double > S;
+      point  offset = point( 0.0, 0.0, 0.0 );  // global minus local coordinates of S
+      double dist_surface, dist_collision;
+      if ( sim.deltaTracking( &p ) ) {
+        // delta tracking moves the particle to its next collision, or up to the boundary of its region
+        if ( pc ) { pc->begin( flight_phase ); }
+        S = sim.deltaTrack( &p );
+        dist_surface   = S.first ? S.second : std::numeric_limits<double>::max();
+        dist_collision = S.first ? std::numeric_limits<double>::max() : 0.0;
+        if ( pc ) { pc->end( flight_phase ); }
+      }
+      else if ( p.cellPointer()->sampleFlightFirst( &p ) ) {
+        // sample the flight first; a collision within the safety distance cannot reach any boundary,
+        // so the surfaces are only intersected when the flight may leave the cell
+        if ( pc ) { pc->begin( flight_phase ); }
+        dist_collision = p.cellPointer()->sampleDistance( &p, std::numeric_limits<double>::max(), &bank );
+        if ( dist_collision >= p.safety() && ! p.onSurface() ) {
+          p.setSafety( safetyDistance( &p ) );
+          p.cellPointer()->recordSafety( dist_collision < p.safety() );
+        }
+        if ( pc ) { pc->end( flight_phase ); }
+        if ( dist_collision < p.safety() ) {
+          S = std::make_pair( nullptr, std::numeric_limits<double>::max() );
+        }
+        else {
+          if ( pc ) { pc->begin( intersect_phase ); }
+          S = boundaryIntersect( &p, offset );
+          if ( pc ) { pc->end( intersect_phase ); }
+        }
+        dist_surface = S.second;
+      }
+      else {
+        if ( pc ) { pc->begin( intersect_phase ); }
+        S = boundaryIntersect( &p, offset );
+        if ( pc ) { pc->begin( flight_phase ); }
+        dist_surface = S.second;
+        // forced collisions need the distance to the boundary, so the flight is sampled second
+        dist_collision = p.cellPointer()->sampleDistance( &p, dist_surface, &bank );
+        if ( pc ) { pc->end( flight_phase ); }
+      }
+      double distance = std::fmin( dist_collision, dist_surface );
+
+      // collided particles stop where they enter the DXTRAN sphere, also when it coincides with a cell boundary
+      bool dxtran_entry = false;
+      if ( dx && p.collided() ) {
+        double dist_dxtran = dx->entryDistance( p.getRay() );
+        if ( dist_dxtran < distance + std::numeric_limits<float>::epsilon() ) { distance = dist_dxtran; dxtran_entry = true; }
+      }
+
+      // move particle, calling cell estimators
+      if ( pc ) { pc->begin( scoring_phase ); }
+      p.cellPointer()->moveParticle( &p, distance, ! dxtran_entry && distance != dist_surface );
+      if ( pc ) { pc->end( scoring_phase ); }
+
+      // weight and bank size before the event, for the importance generator and the absorption estimate of k
+      double             w0 = p.wgt();
+      unsigned long long d0 = bank.size();
+
+      // DXTRAN particles already carry this particle's contribution inside the sphere
+      if ( dxtran_entry ) { dx->enter( &p ); }
+
+      // check if particle left cell
+      else if ( distance == dist_surface ) {
+        // cross surface, calling estimator
+        if ( pc ) { pc->begin( scoring_phase ); }
+        if ( S.first ) { S.first->crossSurface( &p, offset ); } // lattice element boundaries have nothing to do
+        if ( pc ) { pc->begin( residency_phase ); }
+        // find which cell particle's in, change p_cell, roulette or split, or kill if void
+        sim.changeResidency( &p, &bank );
+        if ( pc ) { pc->end( residency_phase ); }
+        if ( prof ) { prof->countCrossing(); prof->bankDepth( bank.size() ); }
+      }
+
+      // if it didn't leave cell, it had a collision in the cell
+      else {
+        // sample nuclide and reaction
+        if ( pc ) { pc->begin( scoring_phase ); }
+        for ( auto d : sim.detectors ) { d->scoreCollision( &p ); }
+        p.cellPointer()->scoreCollision( &p );
+        if ( pc ) { pc->begin( collision_phase ); }
+        if ( dx ) { dx->collide( &p, &bank ); }
+        if ( eig ) { eig->collide( &p, h ); }
+        p.cellPointer()->sampleCollision( &p, &bank );
+        if ( eig ) { eig->absorb( w0 - ( p.alive() ? p.wgt() : 0.0 ) ); }
+        sim.weightCutoff( &p );
+        sim.checkWindows( &p, &bank );
+        if ( pc ) { pc->end( collision_phase ); }
+        if ( prof ) { prof->countCollision(); prof->bankDepth( bank.size() ); }
+      }
+      if ( popc ) { popc->control( &bank, nps ); }
+      if ( gen ) { gen->event( &p, w0, d0 ); }
+      
+    } // end particle loop
+
+  } // end history loop
+  if ( prof ) { prof->endHistory(); }
+  if ( gen ) { gen->endHistory(); }
+}
+
+// report the estimators and whatever statistics the variance reduction and tracking options kept
+void reportRun( simulation& sim, double run_time ) {
+  for ( auto e : sim.estimators ) { e->setRunTime( run_time ); e->report(); }
+  if ( sim.windows ) { sim.windows->report(); }
+  if ( sim.dxtran ) { sim.dxtran->report(); }
+  if ( sim.population ) { sim.population->report(); }
+  sim.reportDeltaTracking();
+  sim.reportLostParticles();
+  if ( sim.counters ) { sim.counters->report(); }
+  if ( sim.profiler ) { sim.profiler->report(); }
+}
+
+// transport all histories of a problem and report its estimators
+// seed_offset shifts the random number seeds so repeated runs of one problem are independent
+void runHistories( simulation& sim, unsigned long long seed_offset ) {
 
   // for timing
   std::clock_t start = std::clock();
@@ -38,45 +176,14 @@ int main() {
   std::cout << " Running " << sim.problemName << " for " << sci1 << "E" << sci2 << " histories." << std::endl;
   for ( unsigned long long history = 0 ; history < sim.histories() ; history++ ) {
 
+    // seed each history from its index so any single history can be replayed
+    unsigned long long nps = sim.firstHistory() + history;
+    unsigned long long seed = nps + seed_offset;
+    RN_init_particle( &seed );
+
     // create a new particle from source distributions, make bank, and deposit it in bank
     std::stack< particle > bank = sim.src->sample();
-
-    // loop for a single history
-    while ( ! bank.empty() ) {
-
-      // take a particle from the bank
-      particle p = bank.top();
-      sim.findResidency( &p ); //determine and assign p_cell
-      bank.pop();
-
-      while ( p.alive() ) { // particle loop
-
-        // determine its next action, either media interaction or boundary crossing
-        double dist_collision = -std::log( Urand() ) / p.cellPointer()->macro_xs();
-        std::pair< std::shared_ptr< surface >, double > S = p.cellPointer()->surfaceIntersect( p.getRay() );
-        double dist_surface = S.second;
-        double distance = std::fmin( dist_collision, dist_surface );
-
-        // move particle, calling cell estimators
-        p.cellPointer()->moveParticle( &p, distance );
-
-        // check if particle left cell
-        if ( distance == dist_surface ) {
-          // cross surface, calling estimator
-          S.first->crossSurface( &p );
-          // find which cell particle's in, change p_cell, roulette or split, or kill if void
-          sim.changeResidency( &p, &bank );
-        }
-
-        // if it didn't leave cell, it had a collision in the cell
-        else {
-          // sample nuclide and reaction
-          p.cellPointer()->sampleCollision( &p, &bank );
-        }
-        
-      } // end particle loop
-
-    } // end history loop
+    transportHistory( sim, bank, nps, history );
 
     // print timer
     if ( ( fmod( std::log10( history + 1 ), 1 ) == 0 ) || ( history + 1 == sim.histories() ) ) {
@@ -106,7 +213,87 @@ int main() {
   } // end simulation loop
 
   std::cout << " Done." << std::endl;
-  for ( auto e : sim.estimators ) { e->report(); }
+  reportRun( sim, ( std::clock() - start ) / (double) CLOCKS_PER_SEC );
+}
+
+// power iteration: each cycle runs the given number of histories from the fission bank of the previous one,
+// the first from the source; estimators only keep the histories of active cycles
+void runCycles( simulation& sim ) {
+  std::clock_t start = std::clock();
+  power_iteration* eig = sim.eigenvalue.get();
+  unsigned long long n = sim.histories();
+  std::cout << " Running " << sim.problemName << " for " << eig->numCycles() << " cycles of " << n << " histories." << std::endl;
+  for ( int c = 0 ; c < eig->numCycles() ; c++ ) {
+    eig->beginCycle();
+    for ( unsigned long long history = 0 ; history < n ; history++ ) {
+      unsigned long long nps = sim.firstHistory() + c * n + history;
+      unsigned long long seed = nps;
+      RN_init_particle( &seed );
+
+      std::stack< particle > bank;
+      if ( eig->hasSources() ) { bank.push( eig->source( history ) ); }
+      else { bank = sim.src->sample(); }
+      eig->startHistory( bank.top().wgt() );
+      transportHistory( sim, bank, nps, history );
+
+      for ( auto e : sim.estimators ) { 
+        if ( eig->activeCycle() ) { e->endHistory(); }
+        else { e->discardHistory(); }
+      }
+    }
+    // the resampling seed follows those of all histories
+    eig->endCycle( sim.firstHistory() + eig->numCycles() * n + c );
+  }
+
+  std::cout << " Done." << std::endl;
+  eig->report();
+  reportRun( sim, ( std::clock() - start ) / (double) CLOCKS_PER_SEC );
+}
+
+int main() {
+
+  // user enters the XML file name
+  std::string input_file_name;
+  std::cout << " Enter XML input file name: " << std::endl;
+  std::cin >> input_file_name;
+
+  // load and initialize problem
+  std::shared_ptr< simulation > sim = std::make_shared< simulation > ( input_file_name );
+  if ( sim->eigenvalue ) {
+    runCycles( *sim );
+    return 0;
+  }
+  if ( ! sim->generator ) {
+    runHistories( *sim, 0 );
+    return 0;
+  }
+
+  // importance generator: each iteration reloads the problem with the importances generated by the best
+  // iteration so far, judged by the figure of merit of the target, and those are the importances written out
+  std::vector< double > imp;
+  double best_fom = -1.0;
+  int    best     = 0;
+  int iterations = sim->generator->numIterations();
+  for ( int it = 0 ; it < iterations ; it++ ) {
+    if ( it > 0 ) {
+      sim = std::make_shared< simulation > ( input_file_name );
+      sim->applyImportances( imp );
+    }
+    std::cout << " Importance generator iteration " << it + 1 << " of " << iterations << std::endl;
+    runHistories( *sim, it * sim->histories() );
+
+    // ties keep the later iteration, so a target without a figure of merit follows the last one
+    double fom = sim->generator->figureOfMerit();
+    std::cout << " iteration " << it + 1 << " target FOM = " << fom << std::endl;
+    if ( fom >= best_fom ) {
+      best_fom = fom;
+      best     = it;
+      sim->applyImportances( sim->generator->importances() );
+      imp = sim->importances();
+      sim->generator->write( imp, sim->cellNames() );
+    }
+  }
+  std::cout << " importances generated by iteration " << best + 1 << " of " << iterations << " kept" << std::endl;
 
   return 0;
 }
@@ -2,6 +2,7 @@
 #include <utility>
 #include <memory>
 #include <cassert>
+#include <algorithm>
 
 #include "Random.h"
 #include "Particle.h"
@@ -14,45 +15,240 @@ void material::addNuclide( std::shared_ptr< nuclide > N, double frac ) {
   nuclides.push_back( std::make_pair( N, frac ) ); 
 }
 
-// private utility function that returns sum of atomic fraction * microscopic total xs
-// multiply this by atomic density to get macroscopic cross section
-// (this function is useful to accelerate sampling the nuclide)
-double material::micro_xs() {
-  double xs = 0.0;
-  for ( auto n : nuclides ) { 
-    // first is pointer to nuclide, second is atomic fraction
-    xs += n.first->total_xs() * n.second;
+// sums of atomic fraction * microscopic xs, multiplied by the atomic density for the macroscopic xs,
+// and the running sums that make sampling the nuclide a scan of one contiguous row
+void material::setGroups( int G ) {
+  int N = nuclides.size();
+  ngroups = G;
+  micro_total.assign( G, 0.0 );
+  micro_capture.assign( G, 0.0 );
+  macro_total.assign( G, 0.0 );
+  nuclide_cdf.assign( G * N, 0.0 );
+  noncapture_cdf.assign( G * N, 0.0 );
+  for ( int g = 0 ; g < G ; g++ ) {
+    double s = 0.0, t = 0.0;
+    for ( int i = 0 ; i < N ; i++ ) {
+      // first is pointer to nuclide, second is atomic fraction
+      std::shared_ptr< nuclide > n = nuclides[i].first;
+      micro_total[g]   += n->total_xs( g ) * nuclides[i].second;
+      micro_capture[g] += n->capture_xs( g ) * nuclides[i].second;
+      s += n->total_xs( g ) * nuclides[i].second;
+      t += ( n->total_xs( g ) - n->capture_xs( g ) ) * nuclides[i].second;
+      nuclide_cdf[ g * N + i ]    = s;
+      noncapture_cdf[ g * N + i ] = t;
+    }
+    macro_total[g] = atom_density() * micro_total[g];
   }
-  return xs;
+  at_energy.resize( N );
 }
 
-// return the macroscopic cross section
-double material::macro_xs() {
-  return atom_density() * micro_xs();
+// the union grid holds every energy of every nuclide, so within one of its intervals every nuclide
+// is linear and interpolating the summed macro xs is exact
+void material::setEnergyGrid( bool unionized, int bins ) {
+  int N = nuclides.size();
+  continuous   = true;
+  union_lookup = unionized;
+  ngroups      = 1;
+  at_energy.resize( N );
+  if ( ! union_lookup ) {
+    double m = 0.0;
+    for ( auto n : nuclides ) { m += n.first->max_total_xs() * n.second; }
+    macro_max = atom_density() * m;
+    return;
+  }
+
+  union_energy.clear();
+  for ( auto n : nuclides ) {
+    std::vector< double >& E = n.first->energyGrid();
+    union_energy.insert( union_energy.end(), E.begin(), E.end() );
+  }
+  std::sort( union_energy.begin(), union_energy.end() );
+  union_energy.erase( std::unique( union_energy.begin(), union_energy.end() ), union_energy.end() );
+  union_hash = energy_hash( union_energy, bins );
+
+  int U = union_energy.size();
+  union_index.assign( U * N, 0 );
+  union_total.assign( U, 0.0 );
+  for ( int u = 0 ; u < U ; u++ ) {
+    double s = 0.0;
+    for ( int i = 0 ; i < N ; i++ ) {
+      std::shared_ptr< nuclide > n = nuclides[i].first;
+      std::vector< double >& E = n->energyGrid();
+      int k = std::upper_bound( E.begin(), E.end(), union_energy[u] ) - E.begin() - 1;
+      union_index[ u * N + i ] = std::max( 0, std::min( k, (int) E.size() - 2 ) );
+      s += n->total_xs( n->at( union_index[ u * N + i ], union_energy[u] ) ) * nuclides[i].second;
+    }
+    union_total[u] = atom_density() * s;
+  }
+  macro_max = *std::max_element( union_total.begin(), union_total.end() );
 }
 
-// randomly sample a nuclide based on total cross sections and atomic fractions
-std::shared_ptr< nuclide > material::sample_nuclide() {
-  double u = micro_xs() * Urand();
+double material::macro_xs_at( double E ) {
+  if ( union_lookup ) {
+    int u = union_hash.index( E, union_energy );
+    return energy_hash::at( u, E, union_energy ).interpolate( union_total );
+  }
   double s = 0.0;
-  for ( auto n : nuclides ) {
-    // first is pointer to nuclide, second is atomic fraction
-    s += n.first->total_xs() * n.second;
-    if ( s > u ) { return n.first; }
+  for ( auto n : nuclides ) { s += n.first->total_xs( n.first->locate( E ) ) * n.second; }
+  return atom_density() * s;
+}
+
+// position of the particle on the data of each nuclide, the group itself for multigroup data
+void material::locate( particle* p ) {
+  int N = nuclides.size();
+  if ( ! continuous ) {
+    for ( int i = 0 ; i < N ; i++ ) { at_energy[i] = energy_index( p->group(), 0.0 ); }
+    return;
+  }
+  double E = p->energy();
+  if ( E == located_energy ) { return; }
+  located_energy = E;
+  if ( union_lookup ) {
+    int u = union_hash.index( E, union_energy );
+    for ( int i = 0 ; i < N ; i++ ) { at_energy[i] = nuclides[i].first->at( union_index[ u * N + i ], E ); }
+  }
+  else {
+    for ( int i = 0 ; i < N ; i++ ) { at_energy[i] = nuclides[i].first->locate( E ); }
+  }
+}
+
+// expected number of particles per steradian leaving a collision at scattering cosine mu,
+// the same whether capture is analog or implicit
+double material::emission_density( double mu, particle* p ) {
+  locate( p );
+  double xs = 0.0, t = 0.0;
+  for ( int i = 0 ; i < (int) nuclides.size() ; i++ ) { 
+    xs += nuclides[i].first->emission_xs( mu, at_energy[i] ) * nuclides[i].second;
+    t  += nuclides[i].first->total_xs( at_energy[i] ) * nuclides[i].second;
+  }
+  return xs / t;
+}
+
+// nuclides are picked by their contribution to the emission density, with one group nothing is sampled
+void material::sample_emission( double mu, particle* p ) {
+  if ( ! continuous && ngroups == 1 ) { return; }
+  locate( p );
+  double xs = 0.0;
+  for ( int i = 0 ; i < (int) nuclides.size() ; i++ ) { 
+    xs += nuclides[i].first->emission_xs( mu, at_energy[i] ) * nuclides[i].second;
+  }
+  double u = xs * Urand();
+  double s = 0.0;
+  for ( int i = 0 ; i < (int) nuclides.size() ; i++ ) {
+    s += nuclides[i].first->emission_xs( mu, at_energy[i] ) * nuclides[i].second;
+    if ( s > u ) { nuclides[i].first->sample_emission( mu, at_energy[i], p ); return; }
+  }
+}
+
+// randomly sample a nuclide based on total cross sections and atomic fractions
+std::shared_ptr< nuclide > material::sample_nuclide( int g ) {
+  int N = nuclides.size();
+  const double* cdf = nuclide_cdf.data() + g * N;
+  double u = micro_xs( g ) * Urand();
+  for ( int i = 0 ; i < N ; i++ ) {
+    if ( cdf[i] > u ) { return nuclides[i].first; }
   }
   assert( false ); // should never reach here
   return nullptr;
 }
 
+// randomly sample a nuclide based on non-capture cross sections and atomic fractions
+std::shared_ptr< nuclide > material::sample_noncapture_nuclide( int g ) {
+  int N = nuclides.size();
+  const double* cdf = noncapture_cdf.data() + g * N;
+  double u = ( micro_xs( g ) - capture_micro_xs( g ) ) * Urand();
+  for ( int i = 0 ; i < N ; i++ ) {
+    if ( cdf[i] > u ) { return nuclides[i].first; }
+  }
+  assert( false ); // should never reach here
+  return nullptr;
+}
+
+double material::nu_fission_xs( particle* p ) {
+  locate( p );
+  double xs = 0.0;
+  for ( int i = 0 ; i < (int) nuclides.size() ; i++ ) { xs += nuclides[i].first->nu_fission_xs( at_energy[i] ) * nuclides[i].second; }
+  return atom_density() * xs;
+}
+
+double material::absorption_xs( particle* p ) {
+  locate( p );
+  double xs = 0.0;
+  for ( int i = 0 ; i < (int) nuclides.size() ; i++ ) {
+    xs += ( nuclides[i].first->capture_xs( at_energy[i] ) + nuclides[i].first->fission_xs( at_energy[i] ) ) * nuclides[i].second;
+  }
+  return atom_density() * xs;
+}
+
+// nuclides are picked by their contribution to nu times the fission xs
+void material::sample_fission( particle* p, particle* q ) {
+  locate( p );
+  double u = nu_fission_xs( p ) / atom_density() * Urand();
+  double s = 0.0;
+  for ( int i = 0 ; i < (int) nuclides.size() ; i++ ) {
+    s += nuclides[i].first->nu_fission_xs( at_energy[i] ) * nuclides[i].second;
+    if ( s > u ) { nuclides[i].first->sample_fission( at_energy[i], q ); return; }
+  }
+}
+
+// multigroup data uses the running sums of the group, continuous energy data sums the nuclides at the energy
+std::pair< std::shared_ptr< nuclide >, energy_index > material::collisionNuclide( particle* p, bool noncapture ) {
+  if ( ! continuous ) {
+    int g = p->group();
+    return std::make_pair( noncapture ? sample_noncapture_nuclide( g ) : sample_nuclide( g ), energy_index( g, 0.0 ) );
+  }
+  locate( p );
+  int N = nuclides.size();
+  double t = 0.0;
+  for ( int i = 0 ; i < N ; i++ ) {
+    energy_index x = at_energy[i];
+    t += ( nuclides[i].first->total_xs( x ) - ( noncapture ? nuclides[i].first->capture_xs( x ) : 0.0 ) ) * nuclides[i].second;
+  }
+  double u = t * Urand();
+  double s = 0.0;
+  for ( int i = 0 ; i < N ; i++ ) {
+    energy_index x = at_energy[i];
+    s += ( nuclides[i].first->total_xs( x ) - ( noncapture ? nuclides[i].first->capture_xs( x ) : 0.0 ) ) * nuclides[i].second;
+    if ( s > u ) { return std::make_pair( nuclides[i].first, x ); }
+  }
+  return std::make_pair( nuclides.back().first, at_energy.back() ); // roundoff in the sums
+}
+
 // function that samples an entire collision: sample nuclide, then its reaction, 
 // and finally process that reaction with input pointers to the working particle p
 // and the particle bank
 std::string material::sample_collision( particle* p, std::stack<particle>* bank ) {
+  // implicit capture: the particle survives with its weight reduced by the capture probability
+  // and one of the remaining reactions is sampled
+  if ( implicit_capture ) {
+    double pc;
+    if ( continuous ) {
+      locate( p );
+      double c = 0.0, t = 0.0;
+      for ( int i = 0 ; i < (int) nuclides.size() ; i++ ) {
+        c += nuclides[i].first->capture_xs( at_energy[i] ) * nuclides[i].second;
+        t += nuclides[i].first->total_xs( at_energy[i] ) * nuclides[i].second;
+      }
+      pc = c / t;
+    }
+    else { pc = capture_micro_xs( p->group() ) / micro_xs( p->group() ); }
+    if ( pc >= 1.0 ) {
+      // nothing but capture, no reason to carry a zero weight particle around
+      p->kill();
+      return "capture";
+    }
+    p->adjustWeight( 1.0 - pc );
+    std::pair< std::shared_ptr< nuclide >, energy_index > N = collisionNuclide( p, true );
+    std::shared_ptr< reaction > R = N.first->sample_noncapture_reaction( N.second );
+    R->sample( p, bank );
+    return R->name();
+  }
+
   // first sample nuclide
-  std::shared_ptr< nuclide >  N = sample_nuclide();
+  std::pair< std::shared_ptr< nuclide >, energy_index > N = collisionNuclide( p, false );
 
   // now get the reaction
-  std::shared_ptr< reaction > R = N->sample_reaction();
+  std::shared_ptr< reaction > R = N.first->sample_reaction( N.second );
 
   // finally process the reaction
   R->sample( p, bank );
@@ -7,24 +7,67 @@
 #include <memory>
 
 #include "Nuclide.h"
+#include "EnergyGrid.h"
 
+// setGroups precomputes, for every group, the macroscopic total xs and the running sums over the nuclides
+// used to sample the collision nuclide, each table stored contiguously with the nuclides of one group together
+// with continuous energy data the macroscopic total xs is found either on a unionized grid, holding every
+// energy of every nuclide together with the interval of each nuclide's grid it falls in (one hashed lookup,
+// memory growing with nuclides times union points), or by a hashed lookup into each nuclide's own grid
 class material {
   private:
     std::string material_name;         // name of material
     double      material_atom_density; // atom density b-1 cm-1
     std::vector< std::pair< std::shared_ptr< nuclide >, double > > nuclides;                           // pairs of nuclide and atom fractions
-    double micro_xs();                 // returns micro xs of material for use by macro_xs
+    bool   implicit_capture;           // true if capture reduces weight instead of killing
+    int    ngroups;                    // number of energy groups
+    std::vector< double > micro_total;    // sum of atom fraction * micro total xs of each group
+    std::vector< double > micro_capture;  // the same for capture
+    std::vector< double > macro_total;    // macro total xs of each group
+    std::vector< double > nuclide_cdf;    // [ g * nuclides + i ] running sum of micro_total over nuclides 0..i
+    std::vector< double > noncapture_cdf; // the same for non-capture xs
+    double micro_xs( int g ) { return micro_total[g]; };           // returns micro xs of material
+    double capture_micro_xs( int g ) { return micro_capture[g]; }; // returns capture micro xs of material for implicit capture
+    bool   continuous;                    // true for continuous energy data
+    bool   union_lookup;                  // true to look up energies on the union grid, false on each nuclide's grid
+    std::vector< double > union_energy;   // union of the energy grids of the nuclides
+    std::vector< double > union_total;    // macro total xs at each union grid point
+    std::vector< int >    union_index;    // [ u * nuclides + i ] interval of nuclide i's grid holding union interval u
+    energy_hash           union_hash;     // lookup into the union grid
+    double                macro_max;      // largest macro total xs at any energy
+    std::vector< energy_index > at_energy; // position of the last energy looked up on the data of each nuclide
+    double                located_energy; // that energy
+    void locate( particle* p );                                    // set at_energy for the group or energy of p
+    std::pair< std::shared_ptr< nuclide >, energy_index > collisionNuclide( particle* p, bool noncapture ); // nuclide p collides with
   public:
-    material( std::string label, double aden ) : material_name(label), material_atom_density(aden) {}; // contructor takes name and atom density
+    material( std::string label, double aden ) : material_name(label), material_atom_density(aden) { // contructor takes name and atom density
+      implicit_capture = false; ngroups = 0; continuous = false; union_lookup = false; macro_max = 0.0; located_energy = -1.0;
+    };
     ~material() {};                    // destructor
 
     std::string name() { return material_name; }                      // return material name
     double atom_density() { return material_atom_density; }           // return atom density of material
     std::vector< std::pair< std::shared_ptr< nuclide >, double > > getNuclides() { return nuclides; }; // returns the paired list of nuclides
     void   addNuclide( std::shared_ptr< nuclide >, double );          // add a nuclide with its at%
-    double macro_xs();                // return the material's macro xs
-    std::shared_ptr< nuclide > sample_nuclide();                      // sample nuclide based on cross sections and atom fractions
+    void   setGroups( int G );                                        // build the group tables, once the nuclides are set up
+    void   setEnergyGrid( bool unionized, int bins );                 // prepare continuous energy lookups, on a union grid or not
+    int    numGroups() { return ngroups; };                           // number of energy groups
+    double macro_xs( int g ) { return macro_total[g]; };              // return the material's macro xs in group g
+    double macro_xs_at( double E );                                   // return the material's macro xs at energy E
+    double macro_xs( particle* p ) {                                  // return the material's macro xs for particle p
+      return continuous ? macro_xs_at( p->energy() ) : macro_total[ p->group() ];
+    };
+    double majorant( int g ) { return continuous ? macro_max : macro_total[g]; }; // largest macro xs in group g, or at any energy
+    void   setImplicitCapture( bool on ) { implicit_capture = on; }  // switch between analog and implicit capture
+    std::shared_ptr< nuclide > sample_nuclide( int g );               // sample nuclide based on cross sections and atom fractions
+    std::shared_ptr< nuclide > sample_noncapture_nuclide( int g );    // sample nuclide based on non-capture cross sections
     std::string sample_collision( particle* p, std::stack<particle>* bank ); // samples nuclide, samples reaction from nuclide, calls reaction's sample method, returns reaction name
+    double emission_density( double mu, particle* p );                // expected particles per steradian leaving a collision of p at cosine mu
+    double nu_fission_xs( particle* p );                              // return nu times the macro fission xs for particle p
+    double absorption_xs( particle* p );                              // return the macro capture plus fission xs for particle p
+    void   sample_fission( particle* p, particle* q );                // group and energy of a neutron q born in a fission by p
+    void   sample_emission( double mu, particle* p );                 // change p to the group and energy leaving such a collision,
+                                                                      // for next-event estimators
 };
 
 
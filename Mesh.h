@@ -0,0 +1,98 @@
+#ifndef _MESH_HEADER_
+#define _MESH_HEADER_
+
+#include <cmath>
+#include <limits>
+#include <algorithm>
+
+#include "Point.h"
+
+// regular Cartesian mesh, voxels numbered with x varying fastest
+class cartesian_mesh {
+  private:
+    point  lo, hi;                          // corners of the mesh
+    int    nx, ny, nz;                      // number of voxels along each axis
+    double wx, wy, wz;                      // voxel widths
+  public:
+     cartesian_mesh( point l, point h, int n1, int n2, int n3 ) : lo(l), hi(h), nx(n1), ny(n2), nz(n3) {
+       wx = ( hi.x - lo.x ) / nx;
+       wy = ( hi.y - lo.y ) / ny;
+       wz = ( hi.z - lo.z ) / nz;
+     };
+    ~cartesian_mesh() {};
+
+    point lower() { return lo; };
+    point upper() { return hi; };
+    int   size( int k ) { return k == 0 ? nx : ( k == 1 ? ny : nz ); };   // number of voxels along axis k
+    long long voxels() { return (long long) nx * ny * nz; };
+
+    long long voxel( point x ) {                                         // voxel containing x, -1 outside the mesh
+      if ( x.x < lo.x || x.y < lo.y || x.z < lo.z || x.x >= hi.x || x.y >= hi.y || x.z >= hi.z ) { return -1; }
+      int i = std::min( nx - 1, (int) ( ( x.x - lo.x ) / wx ) );
+      int j = std::min( ny - 1, (int) ( ( x.y - lo.y ) / wy ) );
+      int k = std::min( nz - 1, (int) ( ( x.z - lo.z ) / wz ) );
+      return i + nx * ( j + (long long) ny * k );
+    };
+
+    // walk the flight of length s ending at x in direction u voxel by voxel with the Amanatides-Woo traversal,
+    // calling f( voxel, length ) for each voxel crossed; under the exponential transform the weight decays as
+    // exp( -decay t ) from the start of the flight and length is the decaying weight integrated over the step
+    template< typename F >
+    void walk( point x, point u, double s, double decay, F f ) {
+      // the flight from a to x, parametrized by the distance t from a
+      point  a = point( x.x - s * u.x, x.y - s * u.y, x.z - s * u.z );
+      double d[3]  = { u.x, u.y, u.z };
+      double a0[3] = { a.x, a.y, a.z };
+      double l0[3] = { lo.x, lo.y, lo.z };
+      double h0[3] = { hi.x, hi.y, hi.z };
+      double w[3]  = { wx, wy, wz };
+      int    n[3]  = { nx, ny, nz };
+
+      // clip the flight to the mesh
+      double t0 = 0.0, t1 = s;
+      for ( int k = 0 ; k < 3 ; k++ ) {
+        if ( d[k] == 0.0 ) {
+          if ( a0[k] < l0[k] || a0[k] >= h0[k] ) { return; }
+          continue;
+        }
+        double ta = ( l0[k] - a0[k] ) / d[k], tb = ( h0[k] - a0[k] ) / d[k];
+        t0 = std::fmax( t0, std::fmin( ta, tb ) );
+        t1 = std::fmin( t1, std::fmax( ta, tb ) );
+      }
+      if ( t0 >= t1 ) { return; }
+
+      // voxel the clipped flight starts in, and the distances to its next face along each axis
+      int    i[3], step[3];
+      double next[3], delta[3];
+      for ( int k = 0 ; k < 3 ; k++ ) {
+        i[k] = std::max( 0, std::min( n[k] - 1, (int) std::floor( ( a0[k] + t0 * d[k] - l0[k] ) / w[k] ) ) );
+        if ( d[k] > 0.0 ) {
+          step[k] = 1;  next[k] = ( l0[k] + ( i[k] + 1 ) * w[k] - a0[k] ) / d[k]; delta[k] = w[k] / d[k];
+        }
+        else if ( d[k] < 0.0 ) {
+          step[k] = -1; next[k] = ( l0[k] + i[k] * w[k] - a0[k] ) / d[k];       delta[k] = -w[k] / d[k];
+        }
+        else {
+          step[k] = 0;  next[k] = std::numeric_limits<double>::max();           delta[k] = 0.0;
+        }
+      }
+
+      // walk the voxels, each time crossing the nearest face
+      double t = t0;
+      while ( true ) {
+        int    k   = next[0] < next[1] ? ( next[0] < next[2] ? 0 : 2 ) : ( next[1] < next[2] ? 1 : 2 );
+        double end = std::fmin( next[k], t1 );
+        if ( end > t ) {
+          f( i[0] + nx * ( i[1] + (long long) ny * i[2] ),
+             decay == 0.0 ? end - t : ( std::exp( -decay * t ) - std::exp( -decay * end ) ) / decay );
+        }
+        if ( end >= t1 ) { break; }
+        i[k] += step[k];
+        if ( i[k] < 0 || i[k] >= n[k] ) { break; }
+        t        = end;
+        next[k] += delta[k];
+      }
+    };
+};
+
+#endif
@@ -1,28 +1,107 @@
 #include <vector>
 #include <memory>
 #include <cassert>
+#include <iostream>
+#include <algorithm>
 
 #include "Random.h"
 #include "Nuclide.h"
 
 // add a new reaction to the current nuclide
-void nuclide::addReaction( std::shared_ptr< reaction > R ) { rxn.push_back( R ); }
+void nuclide::addReaction( std::shared_ptr< reaction > R ) {
+  rxn.push_back( R );
+  if ( R->name() != "capture" ) { noncapture_rxn.push_back( R ); }
+}
+
+int nuclide::numGroups() {
+  int G = 1;
+  for ( auto r : rxn ) { G = std::max( G, r->numGroups() ); }
+  return G;
+}
+
+void nuclide::buildTables( int n ) {
+  total.assign( n, 0.0 );
+  capture.assign( n, 0.0 );
+  fission.assign( n, 0.0 );
+  nu_fission.assign( n, 0.0 );
+  for ( auto r : rxn ) {
+    if ( r->numGroups() != n ) {
+      std::cout << " " << r->name() << " in nuclide " << nuclide_name << " has " << r->numGroups() 
+                << ( continuous() ? " energies instead of " : " groups instead of " ) << n << std::endl;
+      throw;
+    }
+    for ( int i = 0 ; i < n ; i++ ) {
+      total[i] += r->xs( i );
+      if ( r->name() == "capture" ) { capture[i] += r->xs( i ); }
+      if ( r->name() == "fission" ) { fission[i] += r->xs( i ); }
+      nu_fission[i] += r->xs( i ) * r->meanMultiplicity();
+    }
+  }
+}
 
-// return the total microscopic cross section
-double nuclide::total_xs() {
+// reactions given for one group apply to all of them, any other number of groups must match
+void nuclide::setGroups( int G ) {
+  for ( auto r : rxn ) { r->setGroups( G ); }
+  buildTables( G );
+}
+
+void nuclide::setEnergyGrid( std::vector< double > E, int bins ) {
+  energy = E;
+  hash   = energy_hash( energy, bins );
+  buildTables( energy.size() );
+}
+
+double nuclide::max_total_xs() {
+  return *std::max_element( total.begin(), total.end() );
+}
+
+// micro xs weighted angular yield, for next-event estimators
+double nuclide::emission_xs( double mu, energy_index x ) {
   double xs = 0.0;
-  for ( auto r : rxn ) { xs += r->xs(); }
+  for ( auto r : noncapture_rxn ) { xs += r->xs( x ) * r->angular_yield( mu ); }
   return xs;
 }
 
+// reactions are picked by their contribution to the angular yield, the group and energy from the one picked
+void nuclide::sample_emission( double mu, energy_index x, particle* p ) {
+  double u = emission_xs( mu, x ) * Urand();
+  double s = 0.0;
+  for ( auto r : noncapture_rxn ) {
+    s += r->xs( x ) * r->angular_yield( mu );
+    if ( s > u ) { r->sampleOutgoing( p ); return; }
+  }
+}
+
+// fission reactions are picked by their contribution to nu times the fission xs
+void nuclide::sample_fission( energy_index x, particle* q ) {
+  double u = nu_fission_xs( x ) * Urand();
+  double s = 0.0;
+  for ( auto r : rxn ) {
+    s += r->xs( x ) * r->meanMultiplicity();
+    if ( s > u ) { r->sampleOutgoing( q ); return; }
+  }
+}
+
 // randomly sample a reaction type from this nuclide
-std::shared_ptr< reaction > nuclide::sample_reaction() {
-  double u = total_xs() * Urand();
+std::shared_ptr< reaction > nuclide::sample_reaction( energy_index x ) {
+  double u = total_xs( x ) * Urand();
   double s = 0.0;
   for ( auto r : rxn ) {
-    s += r->xs();
+    s += r->xs( x );
+    if ( s > u ) { return r; }
+  }
+  assert( x.f != 0.0 ); // only roundoff between interpolated sums gets here
+  return rxn.back();
+}
+
+// randomly sample a reaction other than capture, used when capture is treated implicitly
+std::shared_ptr< reaction > nuclide::sample_noncapture_reaction( energy_index x ) {
+  double u = ( total_xs( x ) - capture_xs( x ) ) * Urand();
+  double s = 0.0;
+  for ( auto r : noncapture_rxn ) {
+    s += r->xs( x );
     if ( s > u ) { return r; }
   }
-  assert( false ); // should never reach here
-  return nullptr;
+  assert( x.f != 0.0 ); // only roundoff between interpolated sums gets here
+  return noncapture_rxn.back();
 }
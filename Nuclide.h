@@ -6,20 +6,46 @@
 #include <memory>
 
 #include "Reaction.h"
+#include "EnergyGrid.h"
 
+// sums of the reaction cross sections are kept in one table per reaction type, each stored contiguously
+// by group, or by point of the energy grid for continuous energy data, which is interpolated lin-lin
 class nuclide {
   private:
     std::string nuclide_name;                        // name of nuclide
     std::vector< std::shared_ptr< reaction > > rxn;  // list of reactions
+    std::vector< std::shared_ptr< reaction > > noncapture_rxn; // reactions other than capture (for implicit capture)
+    std::vector< double > total;                     // total micro xs of each group or grid point
+    std::vector< double > capture;                   // capture micro xs of each group or grid point
+    std::vector< double > fission;                   // fission micro xs of each group or grid point
+    std::vector< double > nu_fission;                // mean multiplicity times fission micro xs of each group or grid point
+    std::vector< double > energy;                    // ascending energy grid in MeV (empty for multigroup data)
+    energy_hash           hash;                      // lookup into the energy grid
+    void buildTables( int n );                       // sum the reactions into the tables, checking they have n values
   public:
-    nuclide( std::string label ) : nuclide_name(label) {};                    // constructor takes name
+    nuclide( std::string label ) : nuclide_name(label) {};    // constructor takes name
     ~nuclide() {};                                   // destructor
 
     std::string name() { return nuclide_name; }      // return name of nuclide
     std::vector< std::shared_ptr< reaction > > getReactions() {return rxn;} ; // return list of reactions
     void addReaction( std::shared_ptr< reaction > ); // add a reaction to the list of reactions
-    double total_xs();                               // return the total micro xs
-    std::shared_ptr< reaction > sample_reaction();   // returns a random reaction based on micro xs
+    int  numGroups();                                // number of groups of the reaction data as given
+    void setGroups( int G );                         // expand the reactions to G groups and build the group tables
+    void setEnergyGrid( std::vector< double > E, int bins ); // continuous energy: the reactions are given on grid E
+    bool continuous() { return ! energy.empty(); };  // true for continuous energy data
+    std::vector< double >& energyGrid() { return energy; };                          // energy grid
+    energy_index locate( double E ) { return hash.locate( E, energy ); };             // position of E on the grid
+    energy_index at( int i, double E ) { return energy_hash::at( i, E, energy ); };  // the same, knowing the interval i
+    double max_total_xs();                           // largest total micro xs of any group or energy
+    double total_xs( energy_index x ) { return x.interpolate( total ); };     // return the total micro xs
+    double capture_xs( energy_index x ) { return x.interpolate( capture ); }; // return the capture micro xs
+    double fission_xs( energy_index x ) { return x.interpolate( fission ); }; // return the fission micro xs
+    double nu_fission_xs( energy_index x ) { return x.interpolate( nu_fission ); }; // return nu times the fission micro xs
+    std::shared_ptr< reaction > sample_reaction( energy_index x );   // returns a random reaction based on micro xs
+    std::shared_ptr< reaction > sample_noncapture_reaction( energy_index x ); // returns a random non-capture reaction based on micro xs
+    double emission_xs( double mu, energy_index x ); // sum of micro xs times particles emitted per steradian at cosine mu
+    void   sample_emission( double mu, energy_index x, particle* p ); // group and energy of p leaving a collision along cosine mu
+    void   sample_fission( energy_index x, particle* q );                // group and energy of a fission neutron q
 };
 
 
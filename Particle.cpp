@@ -9,7 +9,17 @@ particle::particle( point p, point d ) : p_pos(p), p_dir(d) {
   p_dir.normalize();
   exist = true;
   p_wgt = 1.0;
+  p_group = 0;
+  p_energy = 0.0;
   p_cell = nullptr;
+  p_uncollided = false;
+  p_forced = false;
+  p_collided = false;
+  p_surface = nullptr;
+  p_sense = 0;
+  p_safety = 0.0;
+  p_collisions = 0;
+  p_birth_cell = nullptr;
 }
 
 // move the particle along its current trajectory
@@ -17,6 +27,8 @@ void particle::move( double s ) {
   p_pos.x += s * p_dir.x;
   p_pos.y += s * p_dir.y;
   p_pos.z += s * p_dir.z;
+  p_surface = nullptr;
+  p_safety  = std::fmax( 0.0, p_safety - s );
 }
 
 // scatter particle given input direction cosine cos_t0 = mu0
@@ -73,5 +85,14 @@ void particle::adjustWeight( double f ) {
 
 // set the cell pointer for efficiency
 void particle::recordCell( std::shared_ptr< cell > cel ) {
+  if ( cel != p_cell ) { p_safety = 0.0; }
   p_cell = cel;
 }
+
+// set the cell pointer with the coordinates of the cell and the filled cells it is nested in
+void particle::recordLocation( std::shared_ptr< cell > cel, point offset, std::vector< geometry_level >& levels ) {
+  if ( cel != p_cell ) { p_safety = 0.0; }
+  p_cell   = cel;
+  p_offset = offset;
+  p_levels.swap( levels );
+}
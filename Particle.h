@@ -2,17 +2,43 @@
 #define _PARTICLE_HEADER_
 
 #include <memory>
+#include <vector>
 
 #include "Point.h"
 
-class cell; // forward declaration
+class cell;    // forward declarations
+class surface;
+
+// a filled cell the particle is inside of, one per level of nested universes above its material cell
+class geometry_level {
+  public:
+    std::shared_ptr< cell > level_cell;  // filled cell
+    point offset;                        // global minus local coordinates of the cell's surfaces
+    int   element;                       // lattice element the particle is in (-1 if the fill is a universe)
+
+    geometry_level( std::shared_ptr< cell > c, point o, int e ) : level_cell(c), offset(o), element(e) {};
+    ~geometry_level() {};
+};
 
 class particle {
   private:
     point  p_pos, p_dir;              // position and direction of particle
     double p_wgt;                     // particle weight
+    int    p_group;                   // energy group, 0 being the highest energies
+    double p_energy;                  // energy in MeV, for continuous energy data
     bool   exist;                     // true means particle is alive
     std::shared_ptr< cell > p_cell;   // pointer to cell the particle is in
+    point  p_offset;                  // global minus local coordinates of p_cell's surfaces
+    std::vector< geometry_level > p_levels; // filled cells above p_cell, outermost first (empty without universes)
+    bool   p_uncollided;              // true if the particle must stream to the cell boundary without colliding
+    bool   p_forced;                  // true if a forced collision was already made in the current cell
+    bool   p_collided;                // true if the particle left a collision (false for source and DXTRAN particles)
+    surface* p_surface;               // surface the particle sits on after crossing it (null if none)
+    int    p_sense;                   // side of p_surface the particle is moving into
+    point  p_surface_offset;          // global minus local coordinates of p_surface
+    double p_safety;                  // no boundary of p_cell or the cells above it is closer than this
+    int    p_collisions;              // number of collisions since the particle was born
+    cell*  p_birth_cell;              // cell the particle was born in (null until its first flight)
   public:
     particle( point p, point d );     // constructor with position and direction
     ~particle() {};                   // destructor
@@ -20,15 +46,44 @@ class particle {
     point pos() { return p_pos; };    // return particle position
     point dir() { return p_dir; };    // return particle direction 
     double wgt() { return p_wgt; };   // return particle weight
+    int group() { return p_group; };  // return energy group
+    void setGroup( int g ) { p_group = g; }; // change energy group
+    double energy() { return p_energy; };     // return energy
+    void setEnergy( double E ) { p_energy = E; }; // change energy
     bool alive() { return exist; };   // return particle state flag
     ray getRay() { return ray( p_pos, p_dir ); }               // return particle position and direction as ray
+    point localPos() { return point( p_pos.x - p_offset.x, p_pos.y - p_offset.y, p_pos.z - p_offset.z ); }; // position in p_cell's coordinates
+    ray localRay() { return ray( localPos(), p_dir ); }        // ray in p_cell's coordinates
+    point localOffset() { return p_offset; };                  // global minus local coordinates of p_cell's surfaces
+    std::vector< geometry_level >& levels() { return p_levels; }; // filled cells above p_cell
     std::shared_ptr< cell > cellPointer() { return p_cell; }   // return pointer to cell the particle is in
-    void move( double s );            // move particle s units in its current direction
+    void move( double s );            // move particle s units in its current direction, leaving any surface
     void scatter( double mu0 );       // change particle direction by cos_t0=mu0 and uniformly sampled azimuth
     void kill();                      // change exist to false
     void setDirection( point p );     // change p_dir and normalize p_dir again
+    void setPosition( point p ) { p_pos = p; p_safety = 0.0; }; // change p_pos, e.g. across a periodic boundary
     void adjustWeight( double f );    // multiply weight by f
     void recordCell( std::shared_ptr< cell > cel );            // change p_cell to cel
+    void recordLocation( std::shared_ptr< cell > cel, point offset, std::vector< geometry_level >& levels ); // cell, offset and levels above
+    bool uncollided() { return p_uncollided; };                // true if the next flight cannot end in a collision
+    bool forced() { return p_forced; };                        // true if already forced to collide in this cell
+    void setUncollided( bool u ) { p_uncollided = u; };        // set or clear uncollided flight
+    void setForced( bool f ) { p_forced = f; };                // set or clear forced collision flag
+    bool collided() { return p_collided; };                    // true if the current flight started at a collision
+    void setCollided( bool c ) { p_collided = c; };            // set or clear collided flag
+    surface* onSurface() { return p_surface; };                // surface the particle sits on (null if none)
+    int   surfaceSense() { return p_sense; };                  // side of that surface the particle is on
+    point surfaceOffset() { return p_surface_offset; };        // global minus local coordinates of that surface
+    void  setSurface( surface* S, int sense, point offset ) {  // record the surface just crossed and the new side
+      p_surface = S; p_sense = sense; p_surface_offset = offset; p_safety = 0.0;
+    };
+    double safety() { return p_safety; };                      // distance within which no boundary lies, shrinks as p moves
+    void   setSafety( double s ) { p_safety = s; };            // set after computing the safety distance
+    int   collisions() { return p_collisions; };               // number of collisions since birth
+    void  countCollision() { p_collisions++; };                // count a collision
+    void  setCollisions( int n ) { p_collisions = n; };        // set the number of collisions, e.g. for a pseudo-particle
+    cell* birthCell() { return p_birth_cell; };                // cell the particle was born in
+    void  setBirthCell( cell* c ) { p_birth_cell = c; };       // set the birth cell
 };
 
 #endif
@@ -0,0 +1,145 @@
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <string>
+#include <cstring>
+#include <cerrno>
+
+#ifdef __linux__
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#endif
+
+#include "PerfCounter.h"
+
+static const char* phase_names[ num_phases ] = { "flight", "intersect", "residency", "scoring", "collision" };
+static const char* event_names[] = { "cycles", "instructions", "L1D misses", "LLC misses", "branch misses" };
+
+#ifdef __linux__
+// open one event as part of the group led by group_fd (or as leader if group_fd = -1)
+static int open_event( unsigned int type, unsigned long long config, int group_fd ) {
+  struct perf_event_attr attr;
+  std::memset( &attr, 0, sizeof( attr ) );
+  attr.size           = sizeof( attr );
+  attr.type           = type;
+  attr.config         = config;
+  attr.disabled       = ( group_fd == -1 ) ? 1 : 0; // leader starts disabled, members follow it
+  attr.exclude_kernel = 1;
+  attr.exclude_hv     = 1;
+  attr.read_format    = PERF_FORMAT_GROUP;
+  // pid = 0 and cpu = -1 count the calling thread on any cpu
+  return (int) syscall( __NR_perf_event_open, &attr, 0, -1, group_fd, 0 );
+}
+#endif
+
+// open the counter group for the calling thread; any failure leaves the counters disabled
+perf_counters::perf_counters() {
+  enabled   = false;
+  thread_id = 0;
+  num_open  = 0;
+  current   = num_phases;
+  for ( int i = 0 ; i < num_events ; i++ ) { fds[i] = -1; slot[i] = -1; }
+
+#ifdef __linux__
+  thread_id = (long) syscall( SYS_gettid );
+
+  unsigned long long l1d = PERF_COUNT_HW_CACHE_L1D
+                         | ( PERF_COUNT_HW_CACHE_OP_READ << 8 ) | ( PERF_COUNT_HW_CACHE_RESULT_MISS << 16 );
+  unsigned int       types[ num_events ]   = { PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE, PERF_TYPE_HW_CACHE,
+                                               PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE };
+  unsigned long long configs[ num_events ] = { PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS, l1d,
+                                               PERF_COUNT_HW_CACHE_MISSES, PERF_COUNT_HW_BRANCH_MISSES };
+
+  // cycles lead the group; without them there is nothing to report
+  fds[0] = open_event( types[0], configs[0], -1 );
+  if ( fds[0] < 0 ) {
+    std::cout << " hardware counters unavailable (" << std::strerror( errno ) << "), continuing without them" << std::endl;
+    fds[0] = -1;
+    return;
+  }
+  slot[0] = num_open++;
+
+  // remaining events are optional, e.g. cache events are often missing in virtual machines
+  for ( int i = 1 ; i < num_events ; i++ ) {
+    fds[i] = open_event( types[i], configs[i], fds[0] );
+    if ( fds[i] < 0 ) {
+      std::cout << " hardware counter " << event_names[i] << " unavailable, it will not be reported" << std::endl;
+      fds[i] = -1;
+    }
+    else {
+      slot[i] = num_open++;
+    }
+  }
+
+  ioctl( fds[0], PERF_EVENT_IOC_RESET,  PERF_IOC_FLAG_GROUP );
+  ioctl( fds[0], PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP );
+  enabled = true;
+#else
+  std::cout << " hardware counters are only supported on Linux, continuing without them" << std::endl;
+#endif
+
+  last.resize( num_open, 0 );
+  reading.resize( num_open, 0 );
+  totals.resize( num_phases * num_events, 0 );
+  calls.resize( num_phases, 0 );
+}
+
+perf_counters::~perf_counters() {
+#ifdef __linux__
+  for ( int i = 0 ; i < num_events ; i++ ) {
+    if ( fds[i] >= 0 ) { close( fds[i] ); }
+  }
+#endif
+}
+
+// a group read returns the number of events followed by one value per open event
+bool perf_counters::readGroup( std::vector< unsigned long long >& values ) {
+#ifdef __linux__
+  unsigned long long buffer[ num_events + 1 ];
+  ssize_t bytes = read( fds[0], buffer, sizeof( buffer ) );
+  if ( bytes < (ssize_t) ( ( num_open + 1 ) * sizeof( unsigned long long ) ) ) { return false; }
+  values.assign( buffer + 1, buffer + 1 + num_open );
+  return true;
+#else
+  return false;
+#endif
+}
+
+// a failed read drops the running phase rather than charging it with a stale start
+void perf_counters::transition( transport_phase next ) {
+  if ( ! readGroup( reading ) ) { current = num_phases; return; }
+  if ( current != num_phases ) {
+    for ( int i = 0 ; i < num_events ; i++ ) {
+      if ( slot[i] >= 0 ) { totals[ current * num_events + i ] += reading[ slot[i] ] - last[ slot[i] ]; }
+    }
+    calls[current]++;
+  }
+  last.swap( reading );
+  current = next;
+}
+
+void perf_counters::report() {
+  if ( ! enabled ) { return; }
+  std::streamsize precision = std::cout.precision();
+  std::cout << " hardware counters for thread " << thread_id << std::endl;
+  std::cout << "   " << std::setw(10) << "phase" << std::setw(12) << "calls";
+  for ( int i = 0 ; i < num_events ; i++ ) {
+    if ( slot[i] >= 0 ) { std::cout << std::setw(16) << event_names[i]; }
+  }
+  std::cout << std::setw(8) << "IPC" << std::endl;
+
+  for ( int ph = 0 ; ph < num_phases ; ph++ ) {
+    std::cout << "   " << std::setw(10) << phase_names[ph] << std::setw(12) << calls[ph];
+    for ( int i = 0 ; i < num_events ; i++ ) {
+      if ( slot[i] >= 0 ) { std::cout << std::setw(16) << totals[ ph * num_events + i ]; }
+    }
+    // instructions per cycle tells compute-bound (high) from stall-bound (low) phases
+    double cycles = totals[ ph * num_events ];
+    if ( slot[1] >= 0 && cycles > 0.0 ) {
+      std::cout << std::setw(8) << std::setprecision(3) << totals[ ph * num_events + 1 ] / cycles;
+    }
+    std::cout << std::setprecision( precision ) << std::endl;
+  }
+}
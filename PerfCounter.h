@@ -0,0 +1,46 @@
+#ifndef _PERFCOUNTER_HEADER_
+#define _PERFCOUNTER_HEADER_
+
+#include <string>
+#include <vector>
+
+// phases of the transport loop that can be bracketed by hardware counters
+enum transport_phase { flight_phase, intersect_phase, residency_phase, scoring_phase, collision_phase, num_phases };
+
+// hardware performance counters (Linux perf_event_open) read around transport phases
+// counters are opened for the calling thread only; transport runs on a single thread, so the counts of that
+// thread are the totals of the run and there is nothing to aggregate across threads
+// if the counters cannot be opened (no kernel support, paranoid setting, ...), the object stays disabled
+// and begin/end return immediately
+class perf_counters {
+  private:
+    static const int num_events = 5;                     // cycles, instructions, L1D misses, LLC misses, branch misses
+    bool   enabled;                                      // true if at least the group leader could be opened
+    long   thread_id;                                    // id of the thread the counters are attached to
+    int    fds[ num_events ];                            // file descriptors of each event (-1 if unavailable)
+    int    slot[ num_events ];                           // position of each event in a group read (-1 if unavailable)
+    int    num_open;                                     // number of events open in the group
+    transport_phase current;                             // phase being measured, num_phases between phases
+    std::vector< unsigned long long > last;              // counter values at the last read
+    std::vector< unsigned long long > reading;           // counter values of the read in progress
+    std::vector< unsigned long long > totals;            // accumulated counts [ phase * num_events + event ]
+    std::vector< unsigned long long > calls;             // number of times each phase was measured
+    bool   readGroup( std::vector< unsigned long long >& values ); // read all open counters at once
+    void   transition( transport_phase next );           // one read, charged to the current phase, then switch to next
+  public:
+     perf_counters();                                    // opens counters for the calling thread
+    ~perf_counters();                                    // closes counters
+
+    // a phase runs until its end() or the next begin(), each call reads the counters once,
+    // so back to back phases share the read between them
+    bool active() { return enabled; };                   // true if counters are being read
+    void begin( transport_phase ph ) {                   // close the running phase, if any, and start ph
+      if ( enabled ) { transition( ph ); }
+    };
+    void end( transport_phase ph ) {                     // close ph if it is the running phase
+      if ( enabled && ph == current ) { transition( num_phases ); }
+    };
+    void report();                                       // print per phase totals and derived ratios
+};
+
+#endif
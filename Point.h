@@ -10,6 +10,7 @@ class point {
     ~point() {};
 
     void normalize();
+    bool operator==( const point& p ) const { return x == p.x && y == p.y && z == p.z; }; // exact comparison for discrete points
 };
 
 // a ray in 3d space; has a point of origin and a direction unit vector
@@ -0,0 +1,48 @@
+#include <iostream>
+#include <vector>
+#include <algorithm>
+
+#include "Random.h"
+#include "Population.h"
+
+population_control::population_control( unsigned long long m, unsigned long long t ) : max_bank(m), target(t) {
+  ncomb = 0; nremoved = 0; peak = 0; nhist_combed = 0; last_combed = 0;
+}
+
+void population_control::comb( std::stack< particle >* bank ) {
+  // take the bank apart, top first
+  std::vector< particle > old;
+  double W = 0.0;
+  while ( ! bank->empty() ) { 
+    old.push_back( bank->top() ); 
+    W += bank->top().wgt();
+    bank->pop(); 
+  }
+
+  // teeth spaced W / target apart with a random offset, each particle is kept once for every tooth
+  // falling in its share of the total weight and given the weight of one tooth
+  double spacing = W / target;
+  double tooth   = Urand() * spacing;
+  double edge    = 0.0;
+  std::vector< particle > kept;
+  for ( auto p : old ) {
+    edge += p.wgt();
+    double w = p.wgt();
+    while ( tooth < edge && kept.size() < target ) {
+      particle q = p;
+      q.adjustWeight( spacing / w );
+      kept.push_back( q );
+      tooth += spacing;
+    }
+  }
+
+  // rebuild the bank in its original order
+  for ( auto it = kept.rbegin() ; it != kept.rend() ; ++it ) { bank->push( *it ); }
+  ncomb++;
+  nremoved += old.size() - kept.size();
+}
+
+void population_control::report() {
+  std::cout << " population control: " << ncomb << " combs in " << nhist_combed << " histories, " 
+            << nremoved << " particles removed, largest bank " << peak << std::endl;
+}
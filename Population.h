@@ -0,0 +1,32 @@
+#ifndef _POPULATION_HEADER_
+#define _POPULATION_HEADER_
+
+#include <stack>
+#include <algorithm>
+
+#include "Particle.h"
+
+// caps the number of banked particles in a history: once the bank grows past max_bank it is combed
+// down to target particles of equal weight, which keeps the total weight and each particle's expected weight
+class population_control {
+  private:
+    unsigned long long max_bank;                      // largest bank allowed before combing
+    unsigned long long target;                        // bank size after combing
+    unsigned long long ncomb, nremoved, peak;         // statistics
+    unsigned long long nhist_combed, last_combed;     // histories that needed combing
+    void comb( std::stack< particle >* bank );
+  public:
+     population_control( unsigned long long m, unsigned long long t );
+    ~population_control() {};
+
+    void control( std::stack< particle >* bank, unsigned long long nps ) { // comb the bank of history nps if it is too large
+      peak = std::max( peak, (unsigned long long) bank->size() );
+      if ( bank->size() > max_bank ) { 
+        if ( last_combed != nps ) { nhist_combed++; last_combed = nps; }
+        comb( bank ); 
+      }
+    };
+    void report();                                    // print combing statistics
+};
+
+#endif
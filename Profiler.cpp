@@ -0,0 +1,74 @@
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <algorithm>
+#include <cmath>
+
+#include "Profiler.h"
+
+history_profiler::history_profiler( unsigned int n ) : top_n(n) {
+  nhist = 0;
+  histogram.resize( num_bins, 0 );
+  histogram_time.resize( num_bins, 0.0 );
+}
+
+void history_profiler::beginHistory( unsigned long long nps ) {
+  current    = history_cost( nps );
+  start_time = std::chrono::steady_clock::now();
+}
+
+void history_profiler::endHistory() {
+  current.seconds = std::chrono::duration< double >( std::chrono::steady_clock::now() - start_time ).count();
+
+  // bin k holds histories taking [2^(k-1), 2^k) microseconds, bin 0 anything below one microsecond
+  double us  = current.seconds * 1.0e6;
+  int    bin = us < 1.0 ? 0 : std::min( num_bins - 1, 1 + (int) std::floor( std::log2( us ) ) );
+  histogram[bin]++;
+  histogram_time[bin] += current.seconds;
+
+  totals.tracks     += current.tracks;
+  totals.collisions += current.collisions;
+  totals.crossings  += current.crossings;
+  totals.splits     += current.splits;
+  totals.peak_bank   = std::max( totals.peak_bank, current.peak_bank );
+  totals.seconds    += current.seconds;
+  nhist++;
+
+  // keep the n most expensive histories, cheapest of them on top of the heap
+  if ( top.size() < top_n ) { top.push( current ); }
+  else if ( top_n > 0 && current > top.top() ) {
+    top.pop();
+    top.push( current );
+  }
+}
+
+void history_profiler::report() {
+  if ( nhist == 0 ) { return; }
+  std::cout << " history profile over " << nhist << " histories" << std::endl;
+  std::cout << "   mean tracks = "     << (double) totals.tracks     / nhist
+            << "   mean collisions = " << (double) totals.collisions / nhist
+            << "   mean crossings = "  << (double) totals.crossings  / nhist
+            << "   mean splits = "     << (double) totals.splits     / nhist
+            << "   max bank = "        << totals.peak_bank << std::endl;
+
+  // histogram of history times and the share of run time spent in each bin
+  std::cout << "   " << std::setw(12) << "time < (us)" << std::setw(14) << "histories" << std::setw(14) << "% of time" << std::endl;
+  for ( int i = 0 ; i < num_bins ; i++ ) {
+    if ( histogram[i] == 0 ) { continue; }
+    std::cout << "   " << std::setw(12) << std::pow( 2.0, i ) << std::setw(14) << histogram[i]
+              << std::setw(14) << 100.0 * histogram_time[i] / totals.seconds << std::endl;
+  }
+
+  // most expensive histories, most expensive first
+  std::vector< history_cost > worst;
+  while ( ! top.empty() ) { worst.push_back( top.top() ); top.pop(); }
+  std::reverse( worst.begin(), worst.end() );
+  std::cout << "   " << std::setw(14) << "history" << std::setw(14) << "seconds" << std::setw(10) << "tracks"
+            << std::setw(12) << "collisions" << std::setw(12) << "crossings" << std::setw(10) << "splits"
+            << std::setw(10) << "bank" << std::endl;
+  for ( auto h : worst ) {
+    std::cout << "   " << std::setw(14) << h.nps << std::setw(14) << h.seconds << std::setw(10) << h.tracks
+              << std::setw(12) << h.collisions << std::setw(12) << h.crossings << std::setw(10) << h.splits
+              << std::setw(10) << h.peak_bank << std::endl;
+  }
+}
@@ -0,0 +1,59 @@
+#ifndef _PROFILER_HEADER_
+#define _PROFILER_HEADER_
+
+#include <vector>
+#include <queue>
+#include <functional>
+#include <chrono>
+
+// cost of a single history
+class history_cost {
+  public:
+    unsigned long long nps;         // history index (replay with <histories start=nps end=nps/>)
+    unsigned long long tracks;      // number of flights
+    unsigned long long collisions;  // number of collisions
+    unsigned long long crossings;   // number of surface crossings
+    unsigned long long splits;      // number of particles created by splitting
+    unsigned long long peak_bank;   // largest bank size reached
+    double             seconds;     // elapsed wall time
+
+    history_cost( unsigned long long n = 0 ) : nps(n), tracks(0), collisions(0), crossings(0),
+      splits(0), peak_bank(0), seconds(0.0) {};
+    ~history_cost() {};
+
+    // histories are ranked by number of flights, which unlike wall time is free of system noise
+    bool operator>( const history_cost& other ) const {
+      return tracks > other.tracks || ( tracks == other.tracks && seconds > other.seconds );
+    };
+};
+
+// records the cost of each history and keeps a histogram of history times
+// and the most expensive histories (most flights) for replay
+class history_profiler {
+  private:
+    static const int num_bins = 32;                          // log2 bins of history time in microseconds
+    unsigned int top_n;                                      // number of most expensive histories to keep
+    history_cost current;                                    // history being transported
+    std::chrono::steady_clock::time_point start_time;        // start of current history
+    std::vector< unsigned long long > histogram;             // number of histories per time bin
+    std::vector< double >             histogram_time;        // total time spent per time bin
+    std::priority_queue< history_cost, std::vector< history_cost >, std::greater< history_cost > > top; // min-heap of the top N
+    unsigned long long nhist;                                // number of histories profiled
+    history_cost totals;                                     // sums over all histories
+  public:
+     history_profiler( unsigned int n );                     // keep the n most expensive histories
+    ~history_profiler() {};
+
+    void beginHistory( unsigned long long nps );             // reset counters and start timer
+    void endHistory();                                       // stop timer, bin the history and update top N
+    void countTrack()     { current.tracks++; };             // one flight sampled
+    void countCollision() { current.collisions++; };         // one collision processed
+    void countCrossing()  { current.crossings++; };          // one surface crossed
+    void countSplit( unsigned long long n ) { current.splits += n; };   // n particles added by splitting
+    void bankDepth( unsigned long long n ) {                 // record bank size
+      if ( n > current.peak_bank ) { current.peak_bank = n; }
+    };
+    void report();                                           // print histogram and top N list
+};
+
+#endif
@@ -1,3 +1,7 @@
+#include <cmath>
+#include <algorithm>
+
+#include "Random.h"
 #include "Reaction.h"
 #include "Particle.h"
 #include "Distribution.h"
@@ -11,12 +15,87 @@ void  scatter_reaction::sample( particle* p, std::stack< particle >* bank ) {
   // scatter the particle and leave the bank unmodified
   double mu0 = scatter_dist->sample();
   p->scatter( mu0 );
+  sampleOutgoing( p );
+}
+
+void scatter_reaction::sampleOutgoing( particle* p ) {
+  p->setGroup( sampleGroup( p->group() ) );
+  if ( alpha < 1.0 ) { p->setEnergy( p->energy() * ( alpha + ( 1.0 - alpha ) * Urand() ) ); }
+}
+
+void scatter_reaction::setMatrix( std::vector< double > m ) {
+  int G = std::lround( std::sqrt( m.size() ) );
+  if ( G <= 1 ) { rxn_xs.assign( 1, m.empty() ? 0.0 : m[0] ); return; } // one group scatters within itself
+  rxn_xs.assign( G, 0.0 );
+  row_first.clear(); row_start.clear(); row_cdf.clear();
+  for ( int g = 0 ; g < G ; g++ ) {
+    int first = 0, last = G - 1;
+    while ( first < G && m[ g * G + first ] == 0.0 ) { first++; }
+    while ( last > first && m[ g * G + last ] == 0.0 ) { last--; }
+    row_start.push_back( row_cdf.size() );
+    if ( first == G ) {
+      // nothing scatters out of this group, keep the row valid anyway
+      row_first.push_back( g );
+      row_cdf.push_back( 1.0 );
+      continue;
+    }
+    for ( int h = first ; h <= last ; h++ ) { rxn_xs[g] += m[ g * G + h ]; }
+    double c = 0.0;
+    for ( int h = first ; h <= last ; h++ ) {
+      c += m[ g * G + h ];
+      row_cdf.push_back( c / rxn_xs[g] );
+    }
+    row_first.push_back( first );
+  }
+  row_start.push_back( row_cdf.size() );
+}
+
+int scatter_reaction::sampleGroup( int g ) {
+  if ( row_first.empty() ) { return g; }
+  int a = row_start[g], n = row_start[g+1] - a;
+  if ( n == 1 ) { return row_first[g]; }
+  // the last entry takes whatever roundoff leaves above it
+  const double* row = row_cdf.data() + a;
+  return row_first[g] + ( std::upper_bound( row, row + n - 1, Urand() ) - row );
+}
+
+void fission_reaction::setSpectrum( std::vector< double > chi ) {
+  chi_cdf.clear();
+  double c = 0.0, sum = 0.0;
+  for ( auto x : chi ) { sum += x; }
+  for ( auto x : chi ) { c += x; chi_cdf.push_back( c / sum ); }
+}
+
+void fission_reaction::setGroups( int G ) {
+  reaction::setGroups( G );
+  if ( chi_cdf.empty() ) { chi_cdf.push_back( 1.0 ); }
+  else if ( (int) chi_cdf.size() != G ) {
+    std::cout << " fission spectrum has " << chi_cdf.size() << " groups instead of " << G << std::endl;
+    throw;
+  }
+}
+
+void fission_reaction::sampleOutgoing( particle* p ) {
+  p->setGroup( sampleGroup( p->group() ) );
+  if ( theta > 0.0 ) {
+    double c = std::cos( 0.5 * std::acos(-1.0) * Urand() );
+    p->setEnergy( -theta * ( std::log( Urand() ) + std::log( Urand() ) * c * c ) );
+  }
+}
+
+// the birth group does not depend on the group of the incident neutron
+int fission_reaction::sampleGroup( int ) {
+  int n = chi_cdf.size();
+  if ( n <= 1 ) { return 0; }                        // continuous energy data has no groups
+  return std::upper_bound( chi_cdf.begin(), chi_cdf.end() - 1, Urand() ) - chi_cdf.begin();
 }
 
 void  fission_reaction::sample( particle* p, std::stack< particle >* bank ) {
   // create random number of secondaries from multiplicity distributon and
   // push all but one of them into the bank, and set working particle to the last one
   // if no secondaries, kill the particle
+  // in an eigenvalue problem the next generation was already banked at the collision, fission only absorbs
+  if ( banked ) { p->kill(); return; }
 
   int n = multiplicity_dist->sample();
   if ( n <= 0 ) {
@@ -26,12 +105,21 @@ void  fission_reaction::sample( particle* p, std::stack< particle >* bank ) {
     // bank all but last particle (skips if n = 1)
     for ( int i = 0 ; i < (n - 1) ; i++ ) {
       particle q( p->pos(), isotropic->sample() );
+      q.adjustWeight( p->wgt() );         // secondaries carry the weight of the incident particle
       q.recordCell( p->cellPointer() );
+      q.setBirthCell( p->cellPointer().get() );
+      q.setCollided( p->collided() );
+      sampleOutgoing( &q );
       bank->push( q );
     }
-    // set working particle to last one
+    // set working particle to last one, which stays where the incident particle is in nested geometry
+    // (banked ones are located again when they leave the bank)
     particle q( p->pos(), isotropic->sample() );
-    q.recordCell( p->cellPointer() );
+    q.adjustWeight( p->wgt() );
+    q.recordLocation( p->cellPointer(), p->localOffset(), p->levels() );
+    q.setBirthCell( p->cellPointer().get() );      // secondaries are born in the collision's cell
+    q.setCollided( p->collided() );
+    sampleOutgoing( &q );
     *p = q;
   }
 }
@@ -7,58 +7,103 @@
 #include <memory>
 #include <stack>
 #include <utility>
+#include <algorithm>
+#include <cmath>
 
 #include "Particle.h"
 #include "Distribution.h"
+#include "EnergyGrid.h"
 
+// cross sections are given per energy group, a single value standing for every group,
+// or pointwise on the energy grid of the nuclide for continuous energy
 class reaction {
-  private:
-    double rxn_xs;
   protected:
     std::string rxn_name;
+    std::vector< double > rxn_xs;   // micro xs of each group or grid point
   public:
-     reaction( double x ) : rxn_xs(x) {};
+     reaction( std::vector< double > x ) : rxn_xs(x) {};
     ~reaction() {};
 
     virtual std::string name() final { return rxn_name; };
-    virtual double xs() final { return rxn_xs; };
+    virtual double xs( int g ) final { return rxn_xs[g]; };
+    double xs( energy_index x ) { return x.interpolate( rxn_xs ); };   // micro xs at a group or grid position
+    virtual int numGroups() { return rxn_xs.size(); };                 // number of groups of the data as given
+    virtual void setGroups( int G ) {                                  // expand group independent data to G groups
+      if ( rxn_xs.size() == 1 ) { rxn_xs.assign( G, rxn_xs[0] ); }
+    };
     virtual void sample( particle* p, std::stack<particle>* bank ) = 0; // pure virtual
+    virtual double angular_yield( double mu ) = 0;                     // expected particles emitted per steradian at scattering cosine mu
+    virtual int sampleGroup( int g ) { return g; };                    // group of a particle leaving the reaction in group g
+    virtual void sampleOutgoing( particle* ) {};                       // group and energy of a particle leaving the reaction, given
+                                                                       // those of the incident particle; unchanged by default
+    virtual double meanMultiplicity() { return 0.0; };                 // mean number of fission neutrons
 };
 
 class capture_reaction : public reaction {
   private:
  
   public:
-    capture_reaction( double x ) : reaction(x) { rxn_name = "capture"; }; //construct with xs
+    capture_reaction( std::vector< double > x ) : reaction(x) { rxn_name = "capture"; }; //construct with xs
     ~capture_reaction() {};
 
     void sample( particle* p, std::stack<particle>* bank );             // sample capture
+    double angular_yield( double ) { return 0.0; };                     // nothing leaves a capture
 };
 
+// without a transfer matrix particles scatter within their group; a matrix, row g holding the xs from
+// group g to every group, is stored row by row from the first to the last nonzero entry as cumulative
+// probabilities, so sampling the outgoing group searches a short contiguous band
+// in continuous energy, elastic scattering off a target of mass A at rest leaves the particle with an
+// energy uniform between alpha E and E, alpha = ( ( A - 1 ) / ( A + 1 ) )^2, the energy distribution
+// of isotropic scattering in the center of mass; the angle is drawn from the distribution independently
 class scatter_reaction : public reaction {
   private:
+    const double twopi = 2.0 * std::acos(-1.0);
     std::shared_ptr< distribution<double> > scatter_dist; 
+    double alpha;                     // smallest fraction of the energy kept (1 = no energy loss)
+    std::vector< int >    row_first;  // first outgoing group of each row (empty without a matrix)
+    std::vector< int >    row_start;  // start of each row in row_cdf, and the end of the last one
+    std::vector< double > row_cdf;    // cumulative outgoing group probabilities
   public:
-    scatter_reaction( double x, std::shared_ptr< distribution<double> > D ) : // construct with xs and angular distribution
-       reaction(x), scatter_dist(D) { rxn_name = "scatter"; };
+    scatter_reaction( std::vector< double > x, std::shared_ptr< distribution<double> > D ) : // construct with xs and angular distribution
+       reaction(x), scatter_dist(D) { rxn_name = "scatter"; alpha = 1.0; };
     ~scatter_reaction() {};
 
+    void setTargetMass( double A ) { alpha = std::pow( ( A - 1.0 ) / ( A + 1.0 ), 2 ); }; // mass in neutron masses
+    void setMatrix( std::vector< double > m );                          // G by G transfer xs, replaces the xs with the row sums
     void sample( particle* p, std::stack<particle>* bank );             // sample scatter
+    double angular_yield( double mu ) { return scatter_dist->pdf( mu ) / twopi; }; // azimuth is uniform
+    int sampleGroup( int g );                                           // outgoing group from the row of g
+    void sampleOutgoing( particle* p );                                 // group from the matrix, energy from the elastic kinematics
 };
 
+// fission neutrons are born in groups drawn from the spectrum chi, all in group 0 if none is given,
+// and in continuous energy with energies drawn from a Maxwellian of temperature theta
 class fission_reaction : public reaction {
   private:
     std::shared_ptr< distribution<int> >   multiplicity_dist; 
     std::shared_ptr< distribution<point> > isotropic;
+    std::vector< double > chi_cdf;    // cumulative fission spectrum
+    double theta;                     // temperature of the Maxwellian in MeV (0 = multigroup, energy not sampled)
+    bool   banked;                    // true if the neutrons go to the fission bank of an eigenvalue problem
   public:
-    fission_reaction( double x, std::shared_ptr< distribution<int> > D ) : // construct with xs and multiplicity distribution
+    fission_reaction( std::vector< double > x, std::shared_ptr< distribution<int> > D ) : // construct with xs and multiplicity distribution
        reaction(x), multiplicity_dist(D) { 
-         rxn_name = "fission";
+         rxn_name = "fission"; theta = 0.0; banked = false;
          isotropic = std::make_shared< isotropicDirection_distribution > ( "isotropic" ); 
        };
     ~fission_reaction() {};
 
+    void setSpectrum( std::vector< double > chi );                      // fraction of fission neutrons born in each group
+    void setTemperature( double t ) { theta = t; };                     // Maxwellian temperature of continuous energy fission
+    void setBanked( bool b ) { banked = b; };                           // fission absorbs, its neutrons being banked elsewhere
+    double meanMultiplicity() { return multiplicity_dist->mean(); };
+    int  numGroups() { return std::max( rxn_xs.size(), chi_cdf.size() ); };
+    void setGroups( int G );                                            // expand the xs, and default the spectrum to group 0
     void sample( particle* p, std::stack<particle>* bank );             // sample fission
+    double angular_yield( double ) { return multiplicity_dist->mean() * isotropic->pdf( point() ); }; // mean multiplicity, isotropic
+    int sampleGroup( int g );                                           // group of a fission neutron, from chi
+    void sampleOutgoing( particle* p );                                 // group from chi, energy from the Maxwellian
 };
 
 #endif
@@ -1,5 +1,36 @@
 #include "Simulation.h"
 
+// whitespace separated list of numbers, e.g. cross sections by group
+static std::vector< double > readValues( std::string text ) {
+  std::istringstream in( text );
+  std::vector< double > values;
+  double v;
+  while ( in >> v ) { values.push_back( v ); }
+  return values;
+}
+
+// columns of a cross section table, one row per energy; lines starting with # are comments
+static std::vector< std::vector< double > > readTable( std::string file_name ) {
+  std::ifstream in( file_name );
+  if ( ! in ) {
+    std::cout << " cannot open cross section table " << file_name << std::endl;
+    throw;
+  }
+  std::vector< std::vector< double > > columns;
+  std::string line;
+  while ( std::getline( in, line ) ) {
+    std::vector< double > row = readValues( line.substr( 0, line.find( '#' ) ) );
+    if ( row.empty() ) { continue; }
+    if ( columns.empty() ) { columns.resize( row.size() ); }
+    if ( row.size() != columns.size() ) {
+      std::cout << " cross section table " << file_name << " has rows of different lengths " << std::endl;
+      throw;
+    }
+    for ( unsigned int i = 0 ; i < row.size() ; i++ ) { columns[i].push_back( row[i] ); }
+  }
+  return columns;
+}
+
 // constructor reads in the xml file
 simulation::simulation( std::string input_file_name ) {
   // attempt to load
@@ -18,6 +49,84 @@ simulation::simulation( std::string input_file_name ) {
   pugi::xml_node history_node = sim_node.child("histories");
   starthist = history_node.attribute("start").as_ullong();
   endhist = history_node.attribute("end").as_ullong();
+  if ( starthist == 0 ) { starthist = 1; }                  // histories are numbered from 1
+  if ( endhist < starthist ) {
+    std::cout << " last history " << endhist << " is before first history " << starthist << std::endl;
+    throw;
+  }
+
+  // eigenvalue problems run inactive and active cycles of the given number of histories each
+  std::string problem_type = sim_node.attribute("type").as_string( "fixed source" );
+  if ( problem_type == "eigenvalue" ) {
+    pugi::xml_node eigen_node = sim_node.child("eigenvalue");
+    int    inactive = eigen_node.attribute("inactive").as_int( 10 );
+    int    active   = eigen_node.attribute("active").as_int( 50 );
+    double k0       = eigen_node.attribute("k").as_double( 1.0 );
+    if ( inactive < 0 || active < 1 || k0 <= 0.0 ) {
+      std::cout << " eigenvalue problems need inactive >= 0, active >= 1 cycles and a positive k guess " << std::endl;
+      throw;
+    }
+    eigenvalue = std::make_shared< power_iteration > ( inactive, active, histories(), k0 );
+
+    // Shannon entropy mesh, bounding the first fission bank if not given
+    pugi::xml_node entropy_node = eigen_node.child("entropy");
+    if ( entropy_node ) {
+      point lo( entropy_node.attribute("xmin").as_double(), entropy_node.attribute("ymin").as_double(), 
+                entropy_node.attribute("zmin").as_double() );
+      point hi( entropy_node.attribute("xmax").as_double(), entropy_node.attribute("ymax").as_double(), 
+                entropy_node.attribute("zmax").as_double() );
+      int nx = entropy_node.attribute("nx").as_int(1);
+      int ny = entropy_node.attribute("ny").as_int(1);
+      int nz = entropy_node.attribute("nz").as_int(1);
+      if ( nx < 1 || ny < 1 || nz < 1 || hi.x <= lo.x || hi.y <= lo.y || hi.z <= lo.z ) {
+        std::cout << " invalid entropy mesh " << std::endl;
+        throw;
+      }
+      eigenvalue->setEntropyMesh( lo, hi, nx, ny, nz );
+    }
+  }
+  else if ( problem_type != "fixed source" ) {
+    std::cout << " unknown simulation type " << problem_type << std::endl;
+    throw;
+  }
+
+  // optional hardware counter sampling around the transport phases
+  pugi::xml_node counters_node = sim_node.child("counters");
+  if ( counters_node && counters_node.attribute("enable").as_bool() ) {
+    counters = std::make_shared< perf_counters > ();
+    if ( ! counters->active() ) { counters = nullptr; }
+  }
+
+  // optional implicit capture with weight cutoff, survival weight defaults to twice the cutoff
+  weight_cutoff   = 0.0;
+  weight_survival = 0.0;
+  pugi::xml_node implicit_node = sim_node.child("implicitCapture");
+  if ( implicit_node ) {
+    weight_cutoff   = implicit_node.attribute("cutoff").as_double( 0.25 );
+    weight_survival = implicit_node.attribute("survival").as_double( 2.0 * weight_cutoff );
+    if ( weight_survival <= weight_cutoff ) {
+      std::cout << " survival weight " << weight_survival << " must be larger than weight cutoff " << weight_cutoff << std::endl;
+      throw;
+    }
+  }
+
+  // optional per history cost profiler keeping the most expensive histories
+  pugi::xml_node profile_node = sim_node.child("profile");
+  if ( profile_node ) {
+    profiler = std::make_shared< history_profiler > ( profile_node.attribute("top").as_uint(10) );
+  }
+
+  // optional population control combing the bank once it grows past maxBank, by default down to half of it
+  pugi::xml_node population_node = sim_node.child("population");
+  if ( population_node ) {
+    unsigned long long max_bank = population_node.attribute("maxBank").as_ullong( 1000 );
+    unsigned long long target   = population_node.attribute("target").as_ullong( max_bank / 2 );
+    if ( target < 1 || target > max_bank ) {
+      std::cout << " population control target " << target << " must be between 1 and maxBank " << max_bank << std::endl;
+      throw;
+    }
+    population = std::make_shared< population_control > ( max_bank, target );
+  }
 
   // distributions
   pugi::xml_node input_distributions = input_file.child("distributions");
@@ -159,20 +268,46 @@ simulation::simulation( std::string input_file_name ) {
     }
   }
 
-  // iterate over nuclides
+  // iterate over nuclides, cross sections are a single value or one value per energy group,
+  // or continuous energy data from a table: energies in the first column and one column per reaction, in order
   pugi::xml_node input_nuclides = input_file.child("nuclides");
+  std::vector< std::vector< double > > nuclide_energies;
   for ( auto n : input_nuclides ) {
     std::string name = n.attribute("name").value();
 
     std::shared_ptr< nuclide > Nuc = std::make_shared< nuclide > ( n.attribute("name").value() );
     nuclides.push_back( Nuc );
 
+    std::vector< std::vector< double > > table;
+    if ( n.attribute("table") ) {
+      table = readTable( n.attribute("table").value() );
+      int nrxn = std::distance( n.children().begin(), n.children().end() );
+      if ( (int) table.size() != nrxn + 1 ) {
+        std::cout << " table of nuclide " << name << " needs an energy column and " << nrxn << " reaction columns " << std::endl;
+        throw;
+      }
+      std::vector< double >& E = table[0];
+      for ( unsigned int i = 1 ; i < E.size() ; i++ ) {
+        if ( E[i] <= E[i-1] ) {
+          std::cout << " energies of nuclide " << name << " are not increasing " << std::endl;
+          throw;
+        }
+      }
+      if ( E.size() < 2 || E[0] <= 0.0 ) {
+        std::cout << " nuclide " << name << " needs at least two positive energies " << std::endl;
+        throw;
+      }
+    }
+    nuclide_energies.push_back( table.empty() ? std::vector< double > () : table[0] );
+
     // iterate over its reactions
+    int column = 1;
     for ( auto r : n.children() ) {
       std::shared_ptr< reaction > Rxn;
       std::string rxn_type = r.name();
 
-      double xs = r.attribute("xs").as_double();
+      std::vector< double > xs = table.empty() ? readValues( r.attribute("xs").value() ) : table[ column++ ];
+      if ( xs.empty() ) { xs.push_back( 0.0 ); }
       if ( rxn_type == "capture" ) {
         Nuc->addReaction( std::make_shared< capture_reaction > ( xs ) );
       }
@@ -180,7 +315,20 @@ simulation::simulation( std::string input_file_name ) {
         std::string dist_name = r.attribute("distribution").value();
         std::shared_ptr< distribution<double> > scatterDist = findByName( double_distributions, dist_name );
         if ( scatterDist ) {
-          Nuc->addReaction( std::make_shared< scatter_reaction > ( xs, scatterDist ) );
+          std::shared_ptr< scatter_reaction > Scat = std::make_shared< scatter_reaction > ( xs, scatterDist );
+          // group to group transfer xs, row by row from the highest energy group
+          if ( r.attribute("matrix") ) {
+            std::vector< double > m = readValues( r.attribute("matrix").value() );
+            int G = std::lround( std::sqrt( m.size() ) );
+            if ( m.empty() || G * G != (int) m.size() ) {
+              std::cout << " scattering matrix of nuclide " << name << " is not square " << std::endl;
+              throw;
+            }
+            Scat->setMatrix( m );
+          }
+          // continuous energy elastic scattering loses energy on the target of mass awr
+          if ( n.attribute("awr") && ! table.empty() ) { Scat->setTargetMass( n.attribute("awr").as_double() ); }
+          Nuc->addReaction( Scat );
         }
         else {
           std::cout << " unknown scattering distribution " << dist_name << " in nuclide " << name << std::endl;
@@ -191,7 +339,11 @@ simulation::simulation( std::string input_file_name ) {
         std::string mult_dist_name = r.attribute("multiplicity").value();
         std::shared_ptr< distribution<int> > multDist = findByName( int_distributions, mult_dist_name );
         if ( multDist ) {
-          Nuc->addReaction( std::make_shared< fission_reaction > ( xs, multDist ) );
+          std::shared_ptr< fission_reaction > Fis = std::make_shared< fission_reaction > ( xs, multDist );
+          if ( r.attribute("chi") ) { Fis->setSpectrum( readValues( r.attribute("chi").value() ) ); }
+          if ( ! table.empty() ) { Fis->setTemperature( r.attribute("theta").as_double( 1.2895 ) ); }
+          Fis->setBanked( eigenvalue != nullptr );
+          Nuc->addReaction( Fis );
         }
         else {
           std::cout << " unknown multiplicity distribution " << mult_dist_name << " in nuclide " << name << std::endl;
@@ -205,6 +357,32 @@ simulation::simulation( std::string input_file_name ) {
     }
   } 
 
+  // the number of groups is set by the nuclide data, group independent reactions apply to every group;
+  // continuous energy data is looked up on a union grid of each material or hashed into each nuclide's grid
+  num_groups = 1;
+  continuous_energy = false;
+  for ( auto E : nuclide_energies ) { continuous_energy = continuous_energy || ! E.empty(); }
+  pugi::xml_node xs_node = sim_node.child("crossSections");
+  std::string lookup     = xs_node.attribute("lookup").as_string( "union" );
+  int         hash_bins  = xs_node.attribute("hashBins").as_int( 8192 );
+  if ( lookup != "union" && lookup != "hash" ) {
+    std::cout << " unknown cross section lookup " << lookup << std::endl;
+    throw;
+  }
+  if ( continuous_energy ) {
+    for ( unsigned int i = 0 ; i < nuclides.size() ; i++ ) {
+      if ( nuclide_energies[i].empty() ) {
+        std::cout << " nuclide " << nuclides[i]->name() << " has no continuous energy table " << std::endl;
+        throw;
+      }
+      nuclides[i]->setEnergyGrid( nuclide_energies[i], hash_bins );
+    }
+  }
+  else {
+    for ( auto n : nuclides ) { num_groups = std::max( num_groups, n->numGroups() ); }
+    for ( auto n : nuclides ) { n->setGroups( num_groups ); }
+  }
+
   // iterate over materials
   pugi::xml_node input_materials = input_file.child("materials");
   for ( auto m : input_materials ) {
@@ -212,6 +390,7 @@ simulation::simulation( std::string input_file_name ) {
     double      aden = m.attribute("density").as_double();
     
     std::shared_ptr< material > Mat = std::make_shared< material > ( name, aden );    
+    Mat->setImplicitCapture( ! implicit_node.empty() );
     materials.push_back( Mat );
 
     // iterate over nuclides
@@ -223,6 +402,8 @@ simulation::simulation( std::string input_file_name ) {
         Mat->addNuclide( findByName( nuclides, nuclide_name ), frac );
       }
     }
+    if ( continuous_energy ) { Mat->setEnergyGrid( lookup == "union", hash_bins ); }
+    else { Mat->setGroups( num_groups ); }
   }
 
   // iterate over surfaces
@@ -237,7 +418,36 @@ simulation::simulation( std::string input_file_name ) {
       double      b    = s.attribute("b").as_double();
       double      c    = s.attribute("c").as_double();
       double      d    = s.attribute("d").as_double();
-      S = std::make_shared< plane > ( name, a, b, c, d );
+      // axis aligned planes get the cheaper specialized types
+      if      ( b == 0.0 && c == 0.0 && a != 0.0 ) { S = std::make_shared< planex > ( name, a, d ); }
+      else if ( a == 0.0 && c == 0.0 && b != 0.0 ) { S = std::make_shared< planey > ( name, b, d ); }
+      else if ( a == 0.0 && b == 0.0 && c != 0.0 ) { S = std::make_shared< planez > ( name, c, d ); }
+      else { S = std::make_shared< plane > ( name, a, b, c, d ); }
+    }
+    else if ( type == "planex" ) {
+      std::string name = s.attribute("name").value();
+      double      x    = s.attribute("x").as_double();
+      S = std::make_shared< planex > ( name, 1.0, x );
+    }
+    else if ( type == "planey" ) {
+      std::string name = s.attribute("name").value();
+      double      y    = s.attribute("y").as_double();
+      S = std::make_shared< planey > ( name, 1.0, y );
+    }
+    else if ( type == "planez" ) {
+      std::string name = s.attribute("name").value();
+      double      z    = s.attribute("z").as_double();
+      S = std::make_shared< planez > ( name, 1.0, z );
+    }
+    else if ( type == "box" ) {
+      std::string name = s.attribute("name").value();
+      double      xmin = s.attribute("xmin").as_double();
+      double      xmax = s.attribute("xmax").as_double();
+      double      ymin = s.attribute("ymin").as_double();
+      double      ymax = s.attribute("ymax").as_double();
+      double      zmin = s.attribute("zmin").as_double();
+      double      zmax = s.attribute("zmax").as_double();
+      S = std::make_shared< box > ( name, xmin, xmax, ymin, ymax, zmin, zmax );
     }
     else if ( type == "sphere" ) {
       std::string name = s.attribute("name").value();
@@ -272,14 +482,42 @@ simulation::simulation( std::string input_file_name ) {
     surfaces.push_back( S );
   }
 
+  // pair periodic planes once all surfaces are known, bc="periodic" partner="name" on either or both planes
+  for ( auto s : input_surfaces ) {
+    if ( (std::string) s.attribute("bc").value() != "periodic" ) { continue; }
+    std::string name    = s.attribute("name").value();
+    std::string partner = s.attribute("partner").value();
+    std::shared_ptr< plane > A = std::dynamic_pointer_cast< plane >( findByName( surfaces, name ) );
+    std::shared_ptr< plane > B = std::dynamic_pointer_cast< plane >( findByName( surfaces, partner ) );
+    if ( ! A || ! B || A == B ) {
+      std::cout << " periodic surface " << name << " needs a different plane as partner, got " << partner << std::endl;
+      throw;
+    }
+    A->makePeriodic( A->shiftTo( B ), B.get() );
+    B->makePeriodic( B->shiftTo( A ), A.get() );
+  }
+
   // iterate over cells
   pugi::xml_node input_cells = input_file.child("cells");
   for ( auto c : input_cells ) {
     std::string name = c.attribute("name").value();
 
     std::shared_ptr< cell > Cel = std::make_shared< cell > ( name );
+    Cel->setIndex( cells.size() );
     cells.push_back( Cel );
 
+    // cells belong to the outermost universe unless placed in a named one
+    if ( c.attribute("universe") ) {
+      std::string uname = c.attribute("universe").value();
+      std::shared_ptr< universe > U = findByName( universes, uname );
+      if ( ! U ) {
+        U = std::make_shared< universe > ( uname );
+        universes.push_back( U );
+      }
+      U->addCell( Cel );
+    }
+    else { root_cells.push_back( Cel ); }
+
     // cell material
     if ( c.attribute("material") ) {
       std::shared_ptr< material > matPtr = findByName( materials, c.attribute("material").value() );
@@ -296,10 +534,28 @@ simulation::simulation( std::string input_file_name ) {
     if ( c.attribute("importance") ) {
       Cel->setImportance( c.attribute("importance").as_double() );
     }
+
+    // forced collisions for particles entering the cell
+    if ( c.attribute("forced").as_bool() ) {
+      Cel->setForcedCollision( true );
+    }
    
     // iterate over surfaces
     for ( auto s : c.children() ) {
-      if ( (std::string) s.name() == "surface" ) {
+      if ( (std::string) s.name() == "expTransform" ) {
+        // exponential transform along direction (u,v,w) with stretching parameter p, -1 < p < 1
+        double stretch = s.attribute("p").as_double();
+        point  dir( s.attribute("u").as_double(), s.attribute("v").as_double(), s.attribute("w").as_double() );
+        if ( std::fabs( stretch ) >= 1.0 || c.attribute("forced").as_bool() ) {
+          std::cout << " exponential transform in cell " << name << " needs |p| < 1 and no forced collisions" << std::endl;
+          throw;
+        }
+        Cel->setExponentialTransform( stretch, dir );
+      }
+      else if ( (std::string) s.name() == "translate" ) {
+        // origin of the fill, read with the fill below
+      }
+      else if ( (std::string) s.name() == "surface" ) {
         std::string name  = s.attribute("name").value();
         int         sense = s.attribute("sense").as_int();
 
@@ -319,6 +575,84 @@ simulation::simulation( std::string input_file_name ) {
     } 
   }
 
+  // lattices, elements listed by universe name with the first index varying fastest
+  pugi::xml_node input_lattices = input_file.child("lattices");
+  for ( auto l : input_lattices ) {
+    std::string type = l.name();
+    std::string name = l.attribute("name").value();
+    std::shared_ptr< lattice > Lat;
+    if ( type == "rectangular" ) {
+      double x0 = l.attribute("x0").as_double();
+      double y0 = l.attribute("y0").as_double();
+      double px = l.attribute("pitchX").as_double();
+      double py = l.attribute("pitchY").as_double( px );
+      int    nx = l.attribute("nx").as_int();
+      int    ny = l.attribute("ny").as_int( 1 );
+      if ( px <= 0.0 || py <= 0.0 || nx < 1 || ny < 1 ) {
+        std::cout << " invalid pitch or size of lattice " << name << std::endl;
+        throw;
+      }
+      Lat = std::make_shared< rect_lattice > ( name, x0, y0, px, py, nx, ny );
+    }
+    else if ( type == "hexagonal" ) {
+      double x0    = l.attribute("x0").as_double();
+      double y0    = l.attribute("y0").as_double();
+      double pitch = l.attribute("pitch").as_double();
+      int    n     = l.attribute("n").as_int();
+      if ( pitch <= 0.0 || n < 1 ) {
+        std::cout << " invalid pitch or size of lattice " << name << std::endl;
+        throw;
+      }
+      Lat = std::make_shared< hex_lattice > ( name, x0, y0, pitch, n );
+    }
+    else {
+      std::cout << " unknown lattice type " << type << std::endl;
+      throw;
+    }
+
+    std::istringstream elements( l.text().as_string() );
+    std::string uname;
+    int e = 0;
+    while ( elements >> uname ) {
+      std::shared_ptr< universe > U = findByName( universes, uname );
+      if ( ! U ) {
+        std::cout << " unknown universe " << uname << " in lattice " << name << std::endl;
+        throw;
+      }
+      if ( e < Lat->size() ) { Lat->setElement( e, U ); }
+      e++;
+    }
+    if ( e != Lat->size() ) {
+      std::cout << " lattice " << name << " has " << e << " elements for " << Lat->size() << " positions " << std::endl;
+      throw;
+    }
+    lattices.push_back( Lat );
+  }
+
+  // fill cells with universes or lattices, now that all of them are known
+  for ( auto c : input_cells ) {
+    if ( ! c.attribute("fill") ) { continue; }
+    std::string name  = c.attribute("name").value();
+    std::string fname = c.attribute("fill").value();
+    std::shared_ptr< cell > Cel = findByName( cells, name );
+    pugi::xml_node t = c.child("translate");
+    point origin( t.attribute("x").as_double(), t.attribute("y").as_double(), t.attribute("z").as_double() );
+    if ( c.attribute("material") ) {
+      std::cout << " cell " << name << " cannot have both a material and a fill " << std::endl;
+      throw;
+    }
+    std::shared_ptr< universe > U = findByName( universes, fname );
+    std::shared_ptr< lattice >  L = findByName( lattices, fname );
+    if ( U ) { Cel->setFill( U, origin ); }
+    else if ( L ) { Cel->setFill( L, origin ); }
+    else {
+      std::cout << " unknown universe or lattice " << fname << " filling cell " << name << std::endl;
+      throw;
+    }
+  }
+
+  root_group = std::make_shared< cell_group > ( root_cells );
+
   // iterate over estimatators
   pugi::xml_node input_estimators = input_file.child("estimators");
   for ( auto e : input_estimators ) {
@@ -379,6 +713,139 @@ simulation::simulation( std::string input_file_name ) {
         c->attachEstimator( Est );
       }
     }
+    else if ( type == "meshTrackLength" ) {
+      // scored along the flights in every cell, the mesh being walked voxel by voxel
+      point lo( e.attribute("xmin").as_double(), e.attribute("ymin").as_double(), e.attribute("zmin").as_double() );
+      point hi( e.attribute("xmax").as_double(), e.attribute("ymax").as_double(), e.attribute("zmax").as_double() );
+      int nx = e.attribute("nx").as_int(1);
+      int ny = e.attribute("ny").as_int(1);
+      int nz = e.attribute("nz").as_int(1);
+      if ( nx < 1 || ny < 1 || nz < 1 || hi.x <= lo.x || hi.y <= lo.y || hi.z <= lo.z ) {
+        std::cout << " invalid mesh in estimator " << name << std::endl;
+        throw;
+      }
+      // storage is dense, sparse, or auto: sparse for meshes over a million voxels; sparse storage turns dense
+      // once that takes less memory, and binary output lists only the voxels scored
+      std::string storage = e.attribute("storage").as_string("auto");
+      std::string format  = e.attribute("format").as_string("text");
+      if ( ( storage != "dense" && storage != "sparse" && storage != "auto" ) || ( format != "text" && format != "binary" ) ) {
+        std::cout << " unknown storage " << storage << " or format " << format << " in estimator " << name << std::endl;
+        throw;
+      }
+      Est = std::make_shared< mesh_track_length_estimator > ( name, lo, hi, nx, ny, nz,
+        e.attribute("output").as_string( ( name + ( format == "binary" ? ".bin" : ".txt" ) ).c_str() ), storage, format == "binary" );
+      for ( auto c : cells ) {
+        c->attachEstimator( Est );
+      }
+    }
+    else if ( type == "tally" ) {
+      // product of filters, first varying slowest, times whitespace separated scores
+      std::vector< std::shared_ptr< tally_filter > > filters;
+      std::vector< std::shared_ptr< cell > >    filter_cells;    // cells and surfaces events are taken from
+      std::vector< std::shared_ptr< surface > > filter_surfaces;
+      for ( auto f : e.children("filter") ) {
+        std::string ftype = f.attribute("type").value();
+        std::shared_ptr< tally_filter > F;
+        if ( ftype == "cell" || ftype == "birthCell" ) {
+          std::vector< std::shared_ptr< cell > > fcells;
+          for ( auto c : f.children("cell") ) {
+            std::shared_ptr< cell > CellPtr = findByName( cells, c.attribute("name").value() );
+            if ( ! CellPtr ) {
+              std::cout << " unknown cell label " << c.attribute("name").value() << " in tally " << name << std::endl;
+              throw;
+            }
+            fcells.push_back( CellPtr );
+          }
+          if ( ftype == "cell" && filter_cells.empty() ) { filter_cells = fcells; }
+          F = std::make_shared< cell_filter > ( fcells, ftype == "birthCell" );
+        }
+        else if ( ftype == "surface" ) {
+          std::vector< std::shared_ptr< surface > > fsurfaces;
+          for ( auto s : f.children("surface") ) {
+            std::shared_ptr< surface > SurfPtr = findByName( surfaces, s.attribute("name").value() );
+            if ( ! SurfPtr ) {
+              std::cout << " unknown surface label " << s.attribute("name").value() << " in tally " << name << std::endl;
+              throw;
+            }
+            fsurfaces.push_back( SurfPtr );
+          }
+          if ( filter_surfaces.empty() ) { filter_surfaces = fsurfaces; }
+          F = std::make_shared< surface_filter > ( fsurfaces );
+        }
+        else if ( ftype == "cosine" ) {
+          // bin edges; with an axis u v w cosines are taken with it, otherwise with the normal of the surface crossed
+          std::vector< double > edges = readValues( f.attribute("bins").value() );
+          if ( edges.size() < 2 || ! std::is_sorted( edges.begin(), edges.end() ) ) {
+            std::cout << " cosine bins in tally " << name << " need at least two increasing edges " << std::endl;
+            throw;
+          }
+          if ( f.attribute("u") || f.attribute("v") || f.attribute("w") ) {
+            point u( f.attribute("u").as_double(), f.attribute("v").as_double(), f.attribute("w").as_double() );
+            F = std::make_shared< cosine_filter > ( edges, u );
+          }
+          else {
+            F = std::make_shared< cosine_filter > ( edges );
+          }
+        }
+        else if ( ftype == "collisions" ) {
+          F = std::make_shared< collision_filter > ( f.attribute("bins").as_int(1) );
+        }
+        else if ( ftype == "mesh" ) {
+          point lo( f.attribute("xmin").as_double(), f.attribute("ymin").as_double(), f.attribute("zmin").as_double() );
+          point hi( f.attribute("xmax").as_double(), f.attribute("ymax").as_double(), f.attribute("zmax").as_double() );
+          int nx = f.attribute("nx").as_int(1);
+          int ny = f.attribute("ny").as_int(1);
+          int nz = f.attribute("nz").as_int(1);
+          if ( nx < 1 || ny < 1 || nz < 1 || hi.x <= lo.x || hi.y <= lo.y || hi.z <= lo.z ) {
+            std::cout << " invalid mesh in tally " << name << std::endl;
+            throw;
+          }
+          F = std::make_shared< mesh_filter > ( cartesian_mesh( lo, hi, nx, ny, nz ) );
+        }
+        else {
+          std::cout << " unknown filter type " << ftype << " in tally " << name << std::endl;
+          throw;
+        }
+        if ( F->bins() < 1 ) {
+          std::cout << " empty " << ftype << " filter in tally " << name << std::endl;
+          throw;
+        }
+        filters.push_back( F );
+      }
+      std::vector< std::string > scores;
+      std::istringstream score_names( e.attribute("scores").as_string("flux") );
+      std::string score_name;
+      while ( score_names >> score_name ) {
+        if ( ! tally::knownScore( score_name ) ) {
+          std::cout << " unknown score " << score_name << " in tally " << name << std::endl;
+          throw;
+        }
+        scores.push_back( score_name );
+      }
+      std::shared_ptr< tally > T = std::make_shared< tally > ( name, filters, scores, e.attribute("output").value() );
+
+      // flights and collisions are seen in the cells of the first cell filter, or in every cell,
+      // crossings on the surfaces of the surface filter, or on every surface
+      if ( T->hasScore( flux_score ) || T->hasScore( collisions_score ) || T->hasScore( total_score )
+        || T->hasScore( absorption_score ) || T->hasScore( nu_fission_score ) ) {
+        for ( auto c : ( filter_cells.empty() ? cells : filter_cells ) ) { c->attachEstimator( T ); }
+      }
+      if ( T->hasScore( current_score ) ) {
+        for ( auto s : ( filter_surfaces.empty() ? surfaces : filter_surfaces ) ) { s->attachEstimator( T ); }
+      }
+      Est = T;
+    }
+    else if ( type == "pointDetector" ) {
+      point  d( e.attribute("x").as_double(), e.attribute("y").as_double(), e.attribute("z").as_double() );
+      double r0 = e.attribute("radius").as_double( 0.0 );
+      if ( r0 < 0.0 ) {
+        std::cout << " negative exclusion radius in estimator " << name << std::endl;
+        throw;
+      }
+      std::shared_ptr< point_detector_estimator > Det = std::make_shared< point_detector_estimator > ( name, d, r0, root_group );
+      detectors.push_back( Det );
+      Est = Det;
+    }
     else {
       std::cout << "unknown estimator type " << name << std::endl;
       throw;
@@ -386,6 +853,117 @@ simulation::simulation( std::string input_file_name ) {
     estimators.push_back( Est );
   }
 
+  // DXTRAN sphere around a region of interest, with a weight cutoff for its pseudo-particles
+  pugi::xml_node input_dxtran = input_file.child("dxtran");
+  if ( input_dxtran ) {
+    point  c( input_dxtran.attribute("x").as_double(), input_dxtran.attribute("y").as_double(), 
+              input_dxtran.attribute("z").as_double() );
+    double r  = input_dxtran.attribute("radius").as_double();
+    double wc = input_dxtran.attribute("cutoff").as_double( 0.1 );
+    double ws = input_dxtran.attribute("survival").as_double( 2.0 * wc );
+    if ( r <= 0.0 || wc < 0.0 || ( wc > 0.0 && ws <= wc ) ) {
+      std::cout << " invalid dxtran sphere radius or weight cutoff " << std::endl;
+      throw;
+    }
+    dxtran = std::make_shared< dxtran_sphere > ( c, r, wc, ws, root_group );
+  }
+
+  lost_particles = 0; coincident_crossings = 0;
+
+  // delta tracking in regions of cells that need no surface crossings, either all of them
+  // or in hybrid mode only cells with many surfaces and a cross section close to the majorant
+  delta_flights = 0; delta_virtual = 0; delta_exits = 0;
+  pugi::xml_node delta_node = sim_node.child("deltaTracking");
+  if ( delta_node ) {
+    std::string mode = delta_node.attribute("mode").as_string("delta");
+    if ( mode != "delta" && mode != "hybrid" ) {
+      std::cout << " unknown delta tracking mode " << mode << std::endl;
+      throw;
+    }
+    if ( dxtran ) {
+      // collided particles must be stopped where they enter the sphere, which needs every flight traced
+      std::cout << " delta tracking cannot be used with a dxtran sphere " << std::endl;
+      throw;
+    }
+    setupDeltaTracking( mode == "hybrid", delta_node.attribute("minSurfaces").as_int(4), delta_node.attribute("minRatio").as_double(0.5) );
+    if ( eigenvalue && ! majorants.empty() ) { eigenvalue->disableTrackEstimator(); }
+  }
+
+  // the track length estimate of k follows the flights in every cell, after delta tracking is set up
+  // since cells with estimators are left to surface tracking
+  if ( eigenvalue && majorants.empty() ) {
+    std::shared_ptr< estimator > K = std::make_shared< k_track_estimator > ( eigenvalue.get() );
+    for ( auto c : cells ) { c->attachEstimator( K ); }
+  }
+
+  // weight windows on a Cartesian mesh, lower bounds listed with x varying fastest
+  pugi::xml_node input_windows = input_file.child("weightWindow");
+  if ( input_windows ) {
+    point lo( input_windows.attribute("xmin").as_double(), input_windows.attribute("ymin").as_double(), 
+              input_windows.attribute("zmin").as_double() );
+    point hi( input_windows.attribute("xmax").as_double(), input_windows.attribute("ymax").as_double(), 
+              input_windows.attribute("zmax").as_double() );
+    int nx = input_windows.attribute("nx").as_int(1);
+    int ny = input_windows.attribute("ny").as_int(1);
+    int nz = input_windows.attribute("nz").as_int(1);
+    double survival = input_windows.attribute("survival").as_double( 2.5 ); // survival weight / lower bound
+    double upper    = input_windows.attribute("upper").as_double( 5.0 );    // upper bound / lower bound
+    if ( nx < 1 || ny < 1 || nz < 1 || hi.x <= lo.x || hi.y <= lo.y || hi.z <= lo.z || survival < 1.0 || upper < survival ) {
+      std::cout << " invalid weight window mesh or bounds " << std::endl;
+      throw;
+    }
+    windows = std::make_shared< weight_window > ( lo, hi, nx, ny, nz, survival, upper, input_windows.attribute("maxSplit").as_int(10) );
+
+    // without any lower bounds the windows are off, which is useful as a mesh for the generator
+    std::istringstream values( input_windows.text().as_string() );
+    double lower;
+    int    v = 0;
+    while ( values >> lower ) {
+      if ( v < windows->size() ) { windows->setBounds( v, lower ); }
+      v++;
+    }
+    if ( v != 0 && v != windows->size() ) {
+      std::cout << " weight window has " << v << " lower bounds for " << windows->size() << " voxels " << std::endl;
+      throw;
+    }
+  }
+
+  // forward importance generator for a target estimator, on the weight window mesh if there is one
+  pugi::xml_node generator_node = sim_node.child("generator");
+  if ( generator_node ) {
+    std::string target_name = generator_node.attribute("estimator").value();
+    std::shared_ptr< estimator > target = findByName( estimators, target_name );
+    if ( ! target ) {
+      std::cout << " unknown estimator " << target_name << " in generator " << std::endl;
+      throw;
+    }
+    if ( population ) {
+      // the generator attributes scores through the bank depth, which combing rearranges
+      std::cout << " population control cannot be used with the importance generator " << std::endl;
+      throw;
+    }
+    generator = std::make_shared< importance_generator > ( target, windows, cells.size(), 
+      generator_node.attribute("iterations").as_int(3), generator_node.attribute("output").as_string("importances.xml") );
+  }
+
+  // point detectors and DXTRAN pseudo-particles only follow straight lines from the collision, which miss any path
+  // through a reflection or a periodic image (and DXTRAN still kills collided particles arriving that way)
+  if ( ! detectors.empty() || dxtran ) {
+    for ( auto S : surfaces ) {
+      if ( S->isReflecting() || S->isPeriodic() ) {
+        std::cout << " point detectors and dxtran spheres cannot be used with reflecting or periodic surface " << S->name() << std::endl;
+        throw;
+      }
+    }
+  }
+
+  // point detectors and DXTRAN count fission neutrons in the emission density, which eigenvalue problems
+  // bank for the next cycle instead, and the generator reruns whole problems
+  if ( eigenvalue && ( ! detectors.empty() || dxtran || generator ) ) {
+    std::cout << " point detectors, dxtran spheres and the importance generator cannot be used in eigenvalue problems " << std::endl;
+    throw;
+  }
+
   // create source
   pugi::xml_node input_source = input_file.child("source");
   pugi::xml_node input_source_position  = input_source.child("position");
@@ -406,38 +984,273 @@ simulation::simulation( std::string input_file_name ) {
     throw;
   }
 
+  // biased positions, weighted by the ratio of the true to the biased probability
+  if ( input_source_position.attribute("bias") ) {
+    std::string bias_dist_name = input_source_position.attribute("bias").value();
+    std::shared_ptr< distribution< point > > biasDist = findByName( point_distributions, bias_dist_name );
+    if ( ! biasDist ) { 
+      std::cout << " unknown position bias distribution " << bias_dist_name << " in source " << std::endl; 
+      throw;
+    }
+    // the weight is a ratio of densities, or of probabilities of points, but never of one over the other
+    if ( ! posDist->sameKind( *biasDist ) ) {
+      std::cout << " position distribution " << pos_dist_name << " and its bias " << bias_dist_name 
+                << " mix discrete and continuous coordinates " << std::endl;
+      throw;
+    }
+    src->setPositionBias( biasDist );
+  }
+
+  // energy group of source particles, a fixed group g or a spectrum over the groups
+  pugi::xml_node input_source_group = input_source.child("group");
+  if ( input_source_group ) {
+    if ( input_source_group.attribute("spectrum") ) {
+      std::vector< double > s = readValues( input_source_group.attribute("spectrum").value() );
+      if ( (int) s.size() != num_groups ) {
+        std::cout << " source spectrum has " << s.size() << " groups instead of " << num_groups << std::endl;
+        throw;
+      }
+      src->setSpectrum( s );
+    }
+    else {
+      int g = input_source_group.attribute("g").as_int();
+      if ( g < 0 || g >= num_groups ) {
+        std::cout << " source group " << g << " is not one of the " << num_groups << " groups " << std::endl;
+        throw;
+      }
+      src->setGroup( g );
+    }
+  }
+
+  // energy of source particles, required with continuous energy data
+  pugi::xml_node input_source_energy = input_source.child("energy");
+  if ( continuous_energy ) {
+    double E = input_source_energy.attribute("e").as_double();
+    if ( E <= 0.0 ) {
+      std::cout << " continuous energy data needs a positive source energy " << std::endl;
+      throw;
+    }
+    src->setEnergy( E );
+  }
+
+  // directions biased into a cone toward a target point, mixed with isotropic directions
+  pugi::xml_node cone_node = input_source_direction.child("cone");
+  if ( cone_node ) {
+    point  target( cone_node.attribute("x").as_double(), cone_node.attribute("y").as_double(), cone_node.attribute("z").as_double() );
+    double mu       = cone_node.attribute("mu").as_double( 0.9 );
+    double fraction = cone_node.attribute("fraction").as_double( 0.5 );
+    if ( mu <= -1.0 || mu >= 1.0 || fraction < 0.0 || fraction >= 1.0 ) {
+      std::cout << " cone bias needs -1 < mu < 1 and 0 <= fraction < 1 " << std::endl;
+      throw;
+    }
+    if ( dirDist->singular() ) {
+      std::cout << " direction distribution " << dir_dist_name << " has no density and cannot be biased " << std::endl;
+      throw;
+    }
+    src->setDirectionBias( target, mu, fraction );
+  }
+
 }
 
-// rouletting a particle
+// rouletting a particle, survives with probability Ir
 void simulation::roulette( particle* p, double Ir ) {
-  if ( Urand() < Ir ) { p->kill(); }
+  if ( Urand() > Ir ) { p->kill(); }
   else { p->adjustWeight( 1.0 / Ir ); }
 }
 
+// weight cutoff roulette: particles below the cutoff survive with probability wgt / survival weight
+// and are given the survival weight; both are scaled by the cell importance so that
+// particles split into important cells are not immediately rouletted again
+void simulation::weightCutoff( particle* p ) {
+  if ( windows && windows->covers( p->pos() ) ) { return; }  // weight windows take over population control
+  double I = p->cellPointer()->getImportance();
+  if ( weight_cutoff <= 0.0 || ! p->alive() || p->wgt() >= weight_cutoff / I ) { return; }
+  double ws = weight_survival / I;
+  if ( Urand() < p->wgt() / ws ) { p->adjustWeight( ws / p->wgt() ); }
+  else { p->kill(); }
+}
+
 // splitting a particle
 void simulation::split( particle* p, double Ir, std::stack< particle >* bank ) {
   double N = std::floor( Ir + Urand() ); // split particle into N particles
   for (int i = 0; i < N-1; i++ ) {           // make N-1 new particles
-    particle pTemp( p->pos(), p->dir() );
-    pTemp.adjustWeight( p->wgt() / N );  // with reduced weight
+    particle pTemp = *p;                 // copies keep the state of the particle
+    pTemp.adjustWeight( 1.0 / N );       // with reduced weight
     bank->push( pTemp );
   }
   p->adjustWeight( 1.0 / N );            // reduce weight of current (Nth) particle
+  if ( profiler && N > 1 ) { profiler->countSplit( N - 1 ); }
 }
 
-// find the new residency of particle and sets p_cell
-void simulation::findResidency( particle* p ) {
+// cells qualify for delta tracking if nothing has to happen when a particle crosses their surfaces: no estimators,
+// no forced collisions or exponential transform and a nonzero importance; cells of equal importance form a region
+// so no splitting or roulette is skipped, and each region gets the largest cross section of its cells in each group as majorant
+void simulation::setupDeltaTracking( bool hybrid, int min_surfaces, double min_ratio ) {
+  std::vector< double > region_importance;
+  for ( auto c : root_cells ) {
+    // cells nested in universes are left to surface tracking
+    if ( c->isFilled() || c->getImportance() <= 0.0 || c->hasEstimators() || c->hasVarianceReduction() ) { continue; }
+    if ( hybrid && c->numSurfaces() < min_surfaces ) { continue; }  // few surfaces make surface tracking cheap
+    int r = 0;
+    while ( r < (int) region_importance.size() && region_importance[r] != c->getImportance() ) { r++; }
+    if ( r == (int) region_importance.size() ) {
+      region_importance.push_back( c->getImportance() );
+      majorants.resize( majorants.size() + num_groups, 0.0 );
+    }
+    c->setDeltaRegion( r );
+    for ( int g = 0 ; g < num_groups ; g++ ) {
+      majorants[ r * num_groups + g ] = std::fmax( majorants[ r * num_groups + g ], c->majorant( g ) );
+    }
+  }
+
+  // in hybrid mode cells much thinner than their majorant in any group would mostly see virtual collisions there
+  if ( hybrid ) {
+    for ( auto c : cells ) {
+      for ( int g = 0 ; g < num_groups && c->getDeltaRegion() >= 0 ; g++ ) {
+        if ( c->majorant( g ) < min_ratio * majorants[ c->getDeltaRegion() * num_groups + g ] ) { c->setDeltaRegion( -1 ); }
+      }
+    }
+  }
+
+  // drop regions that lost all their cells or have nothing to collide with in some group
   for ( auto c : cells ) {
-    if ( c->testPoint( p->pos() ) ) {
-      p->recordCell(c);
+    for ( int g = 0 ; g < num_groups && c->getDeltaRegion() >= 0 ; g++ ) {
+      if ( majorants[ c->getDeltaRegion() * num_groups + g ] <= 0.0 ) { c->setDeltaRegion( -1 ); }
+    }
+  }
+}
+
+// point location for delta tracking, same convention as findResidency
+std::shared_ptr< cell > simulation::cellAt( point x, surface* on, int sense ) {
+  return root_group->find( x, on, sense );
+}
+
+// delta tracking: tentative flights are sampled with the majorant of the region and accepted as collisions
+// with probability xs / majorant; a flight that stays in a convex cell needs no surface distances at all,
+// any other flight is followed cell by cell, and if it leaves the region the particle is stopped at the
+// boundary, returning the surface and the distance to it so the crossing is handled by surface tracking
+std::pair< std::shared_ptr< surface >, double > simulation::deltaTrack( particle* p ) {
+  int    region = p->cellPointer()->getDeltaRegion();
+  double smaj   = majorants[ region * num_groups + p->group() ];
+  while ( true ) {
+    double s = -std::log( Urand() ) / smaj;
+    std::shared_ptr< cell > c = p->cellPointer();
+    point x = point( p->pos().x + s * p->dir().x, p->pos().y + s * p->dir().y, p->pos().z + s * p->dir().z );
+    delta_flights++;
+    if ( ! ( c->isConvex() && c->testPoint( x ) ) ) {
+      while ( true ) {
+        std::pair< std::shared_ptr< surface >, double > S = c->surfaceIntersect( p->getRay(), p->onSurface() );
+        if ( S.second >= s ) { break; }
+        double step  = S.second;
+        point  next  = point( p->pos().x + step * p->dir().x, p->pos().y + step * p->dir().y, p->pos().z + step * p->dir().z );
+        int    sense = S.first->senseAlong( ray( next, p->dir() ) );
+        std::shared_ptr< cell > n = cellAt( next, S.first.get(), sense );
+        if ( S.first->isReflecting() || S.first->isPeriodic() || ! n || n->getDeltaRegion() != region ) { delta_exits++; return S; }
+        p->move( step );
+        p->setSurface( S.first.get(), sense, point( 0.0, 0.0, 0.0 ) );
+        p->recordCell( n );
+        s -= step;
+        c  = n;
+      }
     }
+    p->move( s );
+    if ( Urand() * smaj < c->macro_xs( p ) ) { return std::make_pair( nullptr, 0.0 ); }
+    delta_virtual++;
   }
 }
 
+void simulation::reportDeltaTracking() {
+  if ( majorants.empty() ) { return; }
+  std::cout << " delta tracking: " << majorants.size() / num_groups << " regions, " << delta_flights << " flights, " 
+            << delta_virtual << " virtual collisions, " << delta_exits << " region exits" << std::endl;
+  for ( auto c : cells ) {
+    if ( c->getDeltaRegion() >= 0 ) {
+      std::cout << "   " << c->name() << " in region " << c->getDeltaRegion() << " with majorant";
+      for ( int g = 0 ; g < num_groups ; g++ ) { std::cout << " " << majorants[ c->getDeltaRegion() * num_groups + g ]; }
+      std::cout << std::endl;
+    }
+  }
+}
+
+// find the new residency of particle and sets p_cell, descending through universes and lattices
+// a particle no cell claims has been lost to a geometry error, it is killed and counted
+void simulation::findResidency( particle* p ) {
+  bool on = p->onSurface();
+  if ( locateParticle( p, *root_group ) ) {
+    if ( on && ! p->onSurface() ) { coincident_crossings++; } // had to step off
+    return;
+  }
+  if ( lost_particles < 10 ) {
+    std::cout << " lost particle at ( " << p->pos().x << ", " << p->pos().y << ", " << p->pos().z << " ) moving ( "
+              << p->dir().x << ", " << p->dir().y << ", " << p->dir().z << " )" << std::endl;
+  }
+  lost_particles++;
+  p->kill();
+}
+
+void simulation::reportLostParticles() {
+  if ( coincident_crossings > 0 ) { std::cout << " " << coincident_crossings << " crossings of coincident surfaces" << std::endl; }
+  if ( lost_particles > 0 ) { std::cout << " " << lost_particles << " particles lost" << std::endl; }
+}
+
+// use generated importances: cell importances, or weight window lower bounds on the mesh
+// regions without a generated value and void cells keep what they had
+void simulation::applyImportances( std::vector< double > imp ) {
+  if ( windows ) {
+    std::vector< double > lower = generator->lowerBounds( imp );
+    for ( int v = 0 ; v < windows->size() ; v++ ) { 
+      if ( lower[v] > 0.0 ) { windows->setBounds( v, lower[v] ); }
+    }
+  }
+  else {
+    for ( auto c : cells ) {
+      if ( c->getImportance() > 0.0 && imp[ c->getIndex() ] > 0.0 ) { c->setImportance( imp[ c->getIndex() ] ); }
+    }
+  }
+}
+
+// current importances, inverse of applyImportances
+std::vector< double > simulation::importances() {
+  std::vector< double > imp;
+  if ( windows ) {
+    for ( int v = 0 ; v < windows->size() ; v++ ) {
+      double lower = windows->getBounds(v).lower;
+      imp.push_back( lower > 0.0 ? 2.0 / ( ( 1.0 + windows->upperRatio() ) * lower ) : 0.0 );
+    }
+  }
+  else {
+    for ( auto c : cells ) { imp.push_back( c->getImportance() ); }
+  }
+  return imp;
+}
+
+// names of all cells in input order
+std::vector< std::string > simulation::cellNames() {
+  std::vector< std::string > names;
+  for ( auto c : cells ) { names.push_back( c->name() ); }
+  return names;
+}
+
+// check weight windows and update profiler with the number of particles split off
+void simulation::checkWindows( particle* p, std::stack< particle >* bank ) {
+  if ( ! windows ) { return; }
+  int n = windows->apply( p, bank );
+  if ( profiler && n > 0 ) { profiler->countSplit( n ); }
+}
+
 // change residency of particle function
 void simulation::changeResidency( particle* p, std::stack< particle >* bank ) {
+  p->setUncollided( false );                     // forced collision bookkeeping restarts in each cell
+  p->setForced( false );
   double I1 = p->cellPointer()->getImportance(); // importance of resident cell before move
   findResidency( p );                            // changes the p_cell
+  if ( ! p->alive() ) { return; }                // lost
+  if ( windows && windows->covers( p->pos() ) ) {
+    // inside the weight windows, importances only mark voids that kill particles
+    if ( p->cellPointer()->getImportance() == 0.0 ) { p->kill(); }
+    else { checkWindows( p, bank ); }
+    return;
+  }
   double Ir = p->cellPointer()->getImportance() / I1; // ratio of importances of resident cells before and after move
   if ( Ir == 0 ) { p->kill(); }                       // particle entered a void and needed to be killed
   else if ( Ir < 1.0 ) { roulette( p, Ir ); }
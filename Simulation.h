@@ -9,6 +9,8 @@
 #include <iostream>
 #include <cassert>
 #include <cmath>
+#include <sstream>
+#include <fstream>
 
 #include "pugixml.hpp"
 #include "Distribution.h"
@@ -20,6 +22,15 @@
 #include "Source.h"
 #include "Particle.h"
 #include "Point.h"
+#include "PerfCounter.h"
+#include "Profiler.h"
+#include "WeightWindow.h"
+#include "Generator.h"
+#include "Dxtran.h"
+#include "Population.h"
+#include "Lattice.h"
+#include "Eigenvalue.h"
+#include "Tally.h"
 
 
 // function that returns an item from a vector of objects of type T by name provided
@@ -43,20 +54,53 @@ class simulation {
     std::vector< std::shared_ptr< material > > materials;                           // all materials
     std::vector< std::shared_ptr< surface > > surfaces;                             // all surfaces
     std::vector< std::shared_ptr< cell > > cells;                                   // all cells
+    std::vector< std::shared_ptr< cell > > root_cells;                              // cells of the outermost universe
+    std::shared_ptr< cell_group > root_group;                                       // the same, prepared for point location
+    std::vector< std::shared_ptr< universe > > universes;                           // all universes other than the outermost
+    std::vector< std::shared_ptr< lattice > > lattices;                             // all lattices
+    double weight_cutoff;                                                           // roulette below this weight (0 = off)
+    double weight_survival;                                                         // weight given to roulette survivors
+    int num_groups;                                                                 // number of energy groups
+    bool continuous_energy;                                                         // true if the nuclides have continuous energy data
+    std::vector< double > majorants;                                                // majorant xs of each delta tracking region and group, [ r * num_groups + g ]
+    unsigned long long delta_flights, delta_virtual, delta_exits;                   // delta tracking statistics
+    void setupDeltaTracking( bool hybrid, int min_surfaces, double min_ratio );     // group eligible cells into delta tracking regions
+    std::shared_ptr< cell > cellAt( point x, surface* on, int sense );              // cell containing x (on surface on with sense), null if none
+    unsigned long long lost_particles;                                              // particles no cell was found for
+    unsigned long long coincident_crossings;                                        // crossings resolved by stepping off coincident surfaces
 
   public:
     std::vector< std::shared_ptr<estimator > > estimators; // BAD PRACTICE TO HAVE PUBLIC DATA I'M SO SORRY
+    std::vector< std::shared_ptr< point_detector_estimator > > detectors; // estimators scored at emissions and collisions
     std::shared_ptr< source > src;                         // the source
     std::string problemName;                               // I MEAN IT I'M VERY SORRY
+    std::shared_ptr< perf_counters > counters;             // hardware counters around transport phases (null if not requested)
+    std::shared_ptr< history_profiler > profiler;          // per history cost profiler (null if not requested)
+    std::shared_ptr< weight_window > windows;              // mesh weight windows, replace cell importances if present
+    std::shared_ptr< importance_generator > generator;     // importance generator (null if not requested)
+    std::shared_ptr< dxtran_sphere > dxtran;               // DXTRAN sphere (null if not requested)
+    std::shared_ptr< population_control > population;      // bank size control (null if not requested)
+    std::shared_ptr< power_iteration > eigenvalue;         // power iteration of an eigenvalue problem (null for fixed source)
 
     simulation( std::string input_file_name );             // constructor takes xml filename and initiates problem
     ~simulation() {};                                      // destructor
 
-    unsigned long long histories() {return endhist; };     // accessing numhist
+    unsigned long long histories() {return endhist - starthist + 1; };   // number of histories to run
+    int numGroups() { return num_groups; };                              // number of energy groups
+    unsigned long long firstHistory() {return starthist; };              // index of the first history (for seeding)
     void roulette( particle* p, double Ir );               // uses the importance ratio Ir to roulette a particle
+    void weightCutoff( particle* p );                      // roulette particle if its weight is below the cutoff
+    void checkWindows( particle* p, std::stack< particle >* bank ); // split or roulette against the weight windows
+    void applyImportances( std::vector< double > imp );    // set cell importances or weight windows from the generator
+    std::vector< double > importances();                   // cell importances, or importances implied by the weight windows
+    std::vector< std::string > cellNames();                // names of all cells
     void split( particle* p, double Ir, std::stack< particle >* bank );             // uses the importance ratio to split a particle
     void findResidency( particle* p );                     // find cell the particle is in, changes p_cell
     void changeResidency( particle* p, std::stack< particle >* bank );              // calls findResidency, changes p_wgt, kills particle if necessary
+    bool deltaTracking( particle* p ) { return p->cellPointer()->getDeltaRegion() >= 0; }; // true if p is delta tracked
+    std::pair< std::shared_ptr< surface >, double > deltaTrack( particle* p );      // move p to its next collision or to the edge of its region
+    void reportDeltaTracking();                                                     // print delta tracking statistics
+    void reportLostParticles();                                                     // print lost particles and coincident surface crossings
 };
 
 #endif
@@ -1,7 +1,58 @@
+#include <cmath>
+#include <algorithm>
+
+#include "Random.h"
 #include "Source.h"
 
+// biased directions are a mixture of uniform in the cone around axis and isotropic,
+// so every direction the true distribution can emit keeps a nonzero probability
+double source::biasedDirectionPdf( point u, point axis ) {
+  double q = ( 1.0 - cone_fraction ) * isotropic->pdf( u );
+  if ( u.x * axis.x + u.y * axis.y + u.z * axis.z >= cone_mu ) {
+    q += cone_fraction / ( 2.0 * std::acos(-1.0) * ( 1.0 - cone_mu ) );
+  }
+  return q;
+}
+
+void source::setSpectrum( std::vector< double > s ) {
+  if ( s.size() <= 1 ) { setGroup( 0 ); return; }
+  double c = 0.0, sum = 0.0;
+  for ( auto x : s ) { sum += x; }
+  group_cdf.clear();
+  for ( auto x : s ) { c += x; group_cdf.push_back( c / sum ); }
+}
+
+// with biasing, the particle weight is the ratio of the true to the biased probability
 std::stack<particle> source::sample() {
   std::stack<particle> pbank;
-  pbank.push( particle( dist_pos->sample(), dist_dir->sample() ) );
+
+  point  pos;
+  double w = 1.0;
+  if ( bias_pos ) {
+    // the biased distribution must cover every position the true distribution can emit
+    pos = bias_pos->sample();
+    w   = dist_pos->pdf( pos ) / bias_pos->pdf( pos );
+  }
+  else { pos = dist_pos->sample(); }
+  emission_wgt = w;
+
+  point axis = point( cone_target.x - pos.x, cone_target.y - pos.y, cone_target.z - pos.z );
+  if ( cone_bias && ( axis.x != 0.0 || axis.y != 0.0 || axis.z != 0.0 ) ) {
+    axis.normalize();
+    particle p( pos, axis );
+    if ( Urand() < cone_fraction ) { p.scatter( 1.0 - Urand() * ( 1.0 - cone_mu ) ); }
+    else { p.setDirection( isotropic->sample() ); }
+    p.adjustWeight( w * dist_dir->pdf( p.dir() ) / biasedDirectionPdf( p.dir(), axis ) );
+    pbank.push( p );
+  }
+  else {
+    particle p( pos, dist_dir->sample() );
+    p.adjustWeight( w );
+    pbank.push( p );
+  }
+  if ( group_cdf.empty() ) { pbank.top().setGroup( src_group ); }
+  else { pbank.top().setGroup( std::upper_bound( group_cdf.begin(), group_cdf.end() - 1, Urand() ) - group_cdf.begin() ); }
+  pbank.top().setEnergy( src_energy );
+  if ( pbank.top().wgt() == 0.0 ) { pbank.top().kill(); } // outside the true distribution, nothing to transport
   return pbank;
 }
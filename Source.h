@@ -3,6 +3,7 @@
 
 #include <stack>
 #include <memory>
+#include <vector>
 
 #include "Point.h"
 #include "Distribution.h"
@@ -12,12 +13,35 @@ class source {
   private:
     std::shared_ptr< distribution< point > > dist_pos; // distribution of position of source particles
     std::shared_ptr< distribution< point > > dist_dir; // distribution of direction of source particles
+    std::shared_ptr< distribution< point > > bias_pos; // biased position distribution (null for analog positions)
+    std::shared_ptr< distribution< point > > isotropic;
+    bool   cone_bias;                                   // true if directions are biased toward cone_target
+    point  cone_target;                                 // point the biased directions head for
+    double cone_mu;                                     // cosine of the half angle of the cone
+    double cone_fraction;                               // fraction of source particles emitted within the cone
+    double emission_wgt;                                // weight of the last source particle before direction biasing
+    int    src_group;                                   // group of source particles without a spectrum
+    std::vector< double > group_cdf;                    // cumulative group spectrum (empty for a single group)
+    double src_energy;                                  // energy of source particles with continuous energy data
+    double biasedDirectionPdf( point u, point axis );   // probability per steradian of the biased direction
   public:
      source( std::shared_ptr< distribution<point> > pos, std::shared_ptr< distribution<point> > dir )
-       : dist_pos(pos), dist_dir(dir) {};            // constructor takes dist_pos and dist_dir
+       : dist_pos(pos), dist_dir(dir) {              // constructor takes dist_pos and dist_dir
+         isotropic = std::make_shared< isotropicDirection_distribution > ( "isotropic" ); 
+         cone_bias = false; emission_wgt = 1.0; src_group = 0; src_energy = 0.0;
+       };
     ~source() {};                                    // destructor
 
+    void setPositionBias( std::shared_ptr< distribution<point> > B ) { bias_pos = B; }; // sample positions from B instead
+    void setDirectionBias( point target, double mu, double fraction ) {                // emit a fraction in a cone toward target
+      cone_bias = true; cone_target = target; cone_mu = mu; cone_fraction = fraction;
+    };
+    void setGroup( int g ) { src_group = g; group_cdf.clear(); };                       // emit all particles in group g
+    void setSpectrum( std::vector< double > s );                                       // emit in groups drawn from spectrum s
+    void setEnergy( double E ) { src_energy = E; };                                    // emit all particles at energy E
     std::stack< particle > sample();                 // returns a bank with one source particle in it
+    double directionPdf( point u ) { return dist_dir->pdf( u ); }; // probability per steradian of emitting along u
+    double emissionWeight() { return emission_wgt; }; // weight of the last source particle for next-event estimators
 };
 
 #endif
@@ -1,6 +1,7 @@
 #include <cmath>
 #include <limits>
 #include <cassert>
+#include <iostream>
 
 #include "Point.h"
 #include "QuadSolver.h"
@@ -40,6 +41,103 @@ point plane::reflect( ray r ) {
    return temp;
 }
 
+// translation normal to both planes that takes a point on this plane onto other, which must be parallel
+point plane::shiftTo( std::shared_ptr< plane > other ) {
+  double n1 = std::sqrt( a*a + b*b + c*c );
+  double n2 = std::sqrt( other->a * other->a + other->b * other->b + other->c * other->c );
+  point  u( a / n1, b / n1, c / n1 );
+  point  v( other->a / n2, other->b / n2, other->c / n2 );
+  double d2 = other->d / n2;
+
+  // orient the other normal along this one
+  double cos_t = u.x * v.x + u.y * v.y + u.z * v.z;
+  if ( cos_t < 0.0 ) { v = point( -v.x, -v.y, -v.z ); d2 = -d2; cos_t = -cos_t; }
+  if ( 1.0 - cos_t > std::numeric_limits<float>::epsilon() ) {
+    std::cout << " periodic planes " << name() << " and " << other->name() << " are not parallel" << std::endl;
+    throw;
+  }
+  double t = d2 - d / n1;
+  return point( t * u.x, t * u.y, t * u.z );
+}
+
+double box::eval( point p ) {
+  return std::fmax( std::fmax( std::fmax( xmin - p.x, p.x - xmax ), std::fmax( ymin - p.y, p.y - ymax ) ),
+                    std::fmax( zmin - p.z, p.z - zmax ) );
+}
+
+// slab test: the ray is inside all three slabs between tnear and tfar, which is where it is in the box
+bool box::slabs( ray r, double& tnear, double& tfar ) {
+  tnear = -std::numeric_limits<double>::max();
+  tfar  =  std::numeric_limits<double>::max();
+  double lo[3] = { xmin, ymin, zmin }, hi[3] = { xmax, ymax, zmax };
+  double p[3]  = { r.pos.x, r.pos.y, r.pos.z }, u[3] = { r.dir.x, r.dir.y, r.dir.z };
+  for ( int i = 0 ; i < 3 ; i++ ) {
+    if ( std::fabs( u[i] ) <= 100.0 * std::numeric_limits<double>::epsilon() ) {
+      // parallel to the slab, never enters it if outside
+      if ( p[i] < lo[i] || p[i] > hi[i] ) { return false; }
+      continue;
+    }
+    double t1 = ( lo[i] - p[i] ) / u[i];
+    double t2 = ( hi[i] - p[i] ) / u[i];
+    tnear = std::fmax( tnear, std::fmin( t1, t2 ) );
+    tfar  = std::fmin( tfar,  std::fmax( t1, t2 ) );
+  }
+  return tnear <= tfar;
+}
+
+point box::normal( point p ) {
+  double dx = std::fmin( std::fabs( p.x - xmin ), std::fabs( p.x - xmax ) );
+  double dy = std::fmin( std::fabs( p.y - ymin ), std::fabs( p.y - ymax ) );
+  double dz = std::fmin( std::fabs( p.z - zmin ), std::fabs( p.z - zmax ) );
+  if ( dx <= dy && dx <= dz ) { return point( std::fabs( p.x - xmin ) < std::fabs( p.x - xmax ) ? -1.0 : 1.0, 0.0, 0.0 ); }
+  else if ( dy <= dz )        { return point( 0.0, std::fabs( p.y - ymin ) < std::fabs( p.y - ymax ) ? -1.0 : 1.0, 0.0 ); }
+  else                        { return point( 0.0, 0.0, std::fabs( p.z - zmin ) < std::fabs( p.z - zmax ) ? -1.0 : 1.0 ); }
+}
+
+double box::distance( ray r ) {
+  double tnear, tfar;
+  if ( ! slabs( r, tnear, tfar ) || tfar <= 0.0 ) { return std::numeric_limits<double>::max(); }
+  return tnear > 0.0 ? tnear : tfar;
+}
+
+// from a face, only a ray moving inward meets the box again, where it leaves through another face
+double box::distanceFrom( ray r ) {
+  double tnear, tfar;
+  if ( senseAlong( r ) > 0 || ! slabs( r, tnear, tfar ) || tfar <= 0.0 ) { return std::numeric_limits<double>::max(); }
+  return tfar;
+}
+
+int box::senseAlong( ray r ) {
+  point n = normal( r.pos );
+  return n.x * r.dir.x + n.y * r.dir.y + n.z * r.dir.z < 0.0 ? -1 : 1;
+}
+
+void box::bound( int sense, point& lo, point& hi ) {
+  if ( sense > 0 ) { return; }
+  lo = point( std::fmax( lo.x, xmin ), std::fmax( lo.y, ymin ), std::fmax( lo.z, zmin ) );
+  hi = point( std::fmin( hi.x, xmax ), std::fmin( hi.y, ymax ), std::fmin( hi.z, zmax ) );
+}
+
+// on an edge or a corner every face the particle is on and moving out of turns it back, as a corner reflector does
+point box::reflect( ray r ) {
+  assert( std::fabs( eval( r.pos ) ) < std::numeric_limits<float>::epsilon() );
+
+  double eps = std::numeric_limits<float>::epsilon();
+  double lo[3] = { xmin, ymin, zmin }, hi[3] = { xmax, ymax, zmax };
+  double p[3]  = { r.pos.x, r.pos.y, r.pos.z }, u[3] = { r.dir.x, r.dir.y, r.dir.z };
+  bool   out = false;
+  for ( int i = 0 ; i < 3 ; i++ ) {
+    if ( ( std::fabs( p[i] - lo[i] ) < eps && u[i] < 0.0 ) || ( std::fabs( p[i] - hi[i] ) < eps && u[i] > 0.0 ) ) { u[i] = -u[i]; out = true; }
+  }
+  if ( out ) { return point( u[0], u[1], u[2] ); }
+
+  // moving in, as the cosine filter asks of any crossing: mirror in the nearest face
+  point  n = normal( r.pos );
+  point  v = r.dir;
+  double t = 2.0 * ( n.x * v.x + n.y * v.y + n.z * v.z );
+  return point( v.x - t * n.x, v.y - t * n.y, v.z - t * n.z );
+}
+
 double sphere::eval( point p ) {
   return std::pow( p.x - x0, 2 ) + std::pow( p.y - y0, 2 ) + std::pow( p.z - z0, 2 )  - rad*rad;
 }
@@ -83,11 +181,14 @@ double cylinderx::distance( ray r ) {
   // difference between each coordinate and current point
   point q( 0.0, p.y - y0, p.z - z0 );
 
-  // put into quadratic equation form: a*s^2 + b*s + c = 0, where a = 1
+  // put into quadratic equation form: a*s^2 + b*s + c = 0, where a is the square of the direction
+  // perpendicular to the axis; a ray parallel to the axis never meets the cylinder
+  double a = 1.0 - u.x * u.x;
+  if ( a <= std::numeric_limits<double>::epsilon() ) { return std::numeric_limits<double>::max(); }
   double b = 2.0 * ( q.x * u.x  +  q.y * u.y  +  q.z * u.z );
   double c = eval( p );
 
-  return quad_solve( 1.0, b, c );
+  return quad_solve( a, b, c );
 }
 
 point cylinderx::reflect( ray r ) {
@@ -115,11 +216,14 @@ double cylinderz::distance( ray r ) {
   // difference between each coordinate and current point
   point q( p.x - x0, p.y - y0, 0.0 );
 
-  // put into quadratic equation form: a*s^2 + b*s + c = 0, where a = 1
+  // put into quadratic equation form: a*s^2 + b*s + c = 0, where a is the square of the direction
+  // perpendicular to the axis; a ray parallel to the axis never meets the cylinder
+  double a = 1.0 - u.z * u.z;
+  if ( a <= std::numeric_limits<double>::epsilon() ) { return std::numeric_limits<double>::max(); }
   double b = 2.0 * ( q.x * u.x  +  q.y * u.y  +  q.z * u.z );
   double c = eval( p );
 
-  return quad_solve( 1.0, b, c );
+  return quad_solve( a, b, c );
 }
 
 point cylinderz::reflect( ray r ) {
@@ -135,3 +239,67 @@ point cylinderz::reflect( ray r ) {
    temp.normalize();
    return temp;
 }
+
+// on the surface c = 0, so the roots of a*s^2 + b*s = 0 are zero and -b/a
+double sphere::distanceFrom( ray r ) {
+  point  q( r.pos.x - x0, r.pos.y - y0, r.pos.z - z0 );
+  double s = -2.0 * ( q.x * r.dir.x  +  q.y * r.dir.y  +  q.z * r.dir.z );
+  return s > 0.0 ? s : std::numeric_limits<double>::max();
+}
+
+int sphere::senseAlong( ray r ) {
+  return ( r.pos.x - x0 ) * r.dir.x + ( r.pos.y - y0 ) * r.dir.y + ( r.pos.z - z0 ) * r.dir.z < 0.0 ? -1 : 1;
+}
+
+double cylinderx::distanceFrom( ray r ) {
+  double a = 1.0 - r.dir.x * r.dir.x;
+  if ( a <= std::numeric_limits<double>::epsilon() ) { return std::numeric_limits<double>::max(); }
+  double s = -2.0 * ( ( r.pos.y - y0 ) * r.dir.y  +  ( r.pos.z - z0 ) * r.dir.z ) / a;
+  return s > 0.0 ? s : std::numeric_limits<double>::max();
+}
+
+int cylinderx::senseAlong( ray r ) {
+  return ( r.pos.y - y0 ) * r.dir.y + ( r.pos.z - z0 ) * r.dir.z < 0.0 ? -1 : 1;
+}
+
+double cylinderz::distanceFrom( ray r ) {
+  double a = 1.0 - r.dir.z * r.dir.z;
+  if ( a <= std::numeric_limits<double>::epsilon() ) { return std::numeric_limits<double>::max(); }
+  double s = -2.0 * ( ( r.pos.x - x0 ) * r.dir.x  +  ( r.pos.y - y0 ) * r.dir.y ) / a;
+  return s > 0.0 ? s : std::numeric_limits<double>::max();
+}
+
+int cylinderz::senseAlong( ray r ) {
+  return ( r.pos.x - x0 ) * r.dir.x + ( r.pos.y - y0 ) * r.dir.y < 0.0 ? -1 : 1;
+}
+
+// the outside of a quadric is unbounded
+void sphere::bound( int sense, point& lo, point& hi ) {
+  if ( sense > 0 ) { return; }
+  lo = point( std::fmax( lo.x, x0 - rad ), std::fmax( lo.y, y0 - rad ), std::fmax( lo.z, z0 - rad ) );
+  hi = point( std::fmin( hi.x, x0 + rad ), std::fmin( hi.y, y0 + rad ), std::fmin( hi.z, z0 + rad ) );
+}
+
+void cylinderx::bound( int sense, point& lo, point& hi ) {
+  if ( sense > 0 ) { return; }
+  lo = point( lo.x, std::fmax( lo.y, y0 - rad ), std::fmax( lo.z, z0 - rad ) );
+  hi = point( hi.x, std::fmin( hi.y, y0 + rad ), std::fmin( hi.z, z0 + rad ) );
+}
+
+void cylinderz::bound( int sense, point& lo, point& hi ) {
+  if ( sense > 0 ) { return; }
+  lo = point( std::fmax( lo.x, x0 - rad ), std::fmax( lo.y, y0 - rad ), lo.z );
+  hi = point( std::fmin( hi.x, x0 + rad ), std::fmin( hi.y, y0 + rad ), hi.z );
+}
+
+double sphere::safety( point p ) {
+  return std::fabs( std::sqrt( std::pow( p.x - x0, 2 ) + std::pow( p.y - y0, 2 ) + std::pow( p.z - z0, 2 ) ) - rad );
+}
+
+double cylinderx::safety( point p ) {
+  return std::fabs( std::sqrt( std::pow( p.y - y0, 2 ) + std::pow( p.z - z0, 2 ) ) - rad );
+}
+
+double cylinderz::safety( point p ) {
+  return std::fabs( std::sqrt( std::pow( p.x - x0, 2 ) + std::pow( p.y - y0, 2 ) ) - rad );
+}
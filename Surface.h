@@ -4,6 +4,8 @@
 #include <string>
 #include <vector>
 #include <limits>
+#include <memory>
+#include <cmath>
 
 #include "Point.h"
 #include "Particle.h"
@@ -13,13 +15,24 @@ class surface {
   private:
     std::string surface_name;  // name of surface
     bool reflect_bc;           // true if reflecting boundary
+    bool periodic_bc;          // true if periodic boundary
+    point periodic_shift;      // translation onto the partner surface of a periodic boundary
+    surface* periodic_partner; // partner surface of a periodic boundary
     std::vector< std::shared_ptr< estimator > > surface_estimators;             // estimators
   public:
-    surface( std::string label ) : surface_name(label) { reflect_bc = false; }; // constructor takes name
+    surface( std::string label ) : surface_name(label) {                     // constructor takes name
+      reflect_bc = false; periodic_bc = false; periodic_partner = nullptr;
+    };
     ~surface() {};
 
     virtual std::string name()    final { return surface_name; };               // return name
     virtual void makeReflecting() final { reflect_bc = true; };                 // make reflector
+    virtual bool isReflecting()   final { return reflect_bc; };                 // true if reflecting boundary
+    virtual void makePeriodic( point shift, surface* partner ) final {          // make periodic boundary, shift takes
+      periodic_bc = true; periodic_shift = shift; periodic_partner = partner;   // a point on it to its partner
+    };
+    virtual bool isPeriodic()     final { return periodic_bc; };                // true if periodic boundary
+    virtual bool hasEstimators()  final { return ! surface_estimators.empty(); }; // true if crossings are scored
 
     virtual void attachEstimator( std::shared_ptr< estimator > E ) final {      // add estimator
       surface_estimators.push_back( E );
@@ -28,36 +41,144 @@ class surface {
       for ( auto e : surface_estimators ) { e->score( p ); }
     }
 
-    virtual void crossSurface( particle* p ) final {                            // scores estimators, reflects, nudges particle
+    virtual void crossSurface( particle* p, point offset ) final {              // scores estimators, reflects or translates, and records
+      surface* S = this;                                                        // the side the particle moves into; offset is global minus
+      point    x = p->pos();                                                    // local coordinates of the surface
+      ray      r = ray( point( x.x - offset.x, x.y - offset.y, x.z - offset.z ), p->dir() );
+
       // score estimators
-      for ( auto e : surface_estimators ) { e->score( p ); }
+      for ( auto e : surface_estimators ) { e->scoreCrossing( p, this, r ); }
 
       // reflect if needed
       if ( reflect_bc ) { 
-        point d = reflect( p->getRay() );
-        p->setDirection( d );
+        p->setDirection( reflect( r ) );
+        r = ray( r.pos, p->dir() );
+      }
+      // translate to the partner surface of a periodic pair, keeping the direction
+      else if ( periodic_bc ) {
+        p->setPosition( point( x.x + periodic_shift.x, x.y + periodic_shift.y, x.z + periodic_shift.z ) );
+        r = ray( point( r.pos.x + periodic_shift.x, r.pos.y + periodic_shift.y, r.pos.z + periodic_shift.z ), r.dir );
+        S = periodic_partner;
       }
 
-      // advance particle off the surface
-      p->move( std::numeric_limits<float>::epsilon() );
+      // the particle stays on the surface, cell lookup uses the known side instead of evaluating it
+      p->setSurface( S, S->senseAlong( r ), offset );
     }
 
     virtual double eval( point p )   = 0;       // pure virtual
     virtual double distance( ray r ) = 0;       // pure virtual
     virtual point  reflect( ray r )  = 0;       // pure virtual
+    virtual double distanceFrom( ray r ) = 0;   // distance from a point on the surface to the next intersection
+    virtual int    senseAlong( ray r ) = 0;     // side a ray from a point on the surface moves into
+    virtual bool   convex( int sense ) { return sense < 0; }; // true if the side given by sense is convex (inside of a quadric)
+    virtual void   bound( int, point&, point& ) {}; // bound( sense, lo, hi ) shrinks the box lo, hi to the side given by sense, unbounded by default
+    virtual double safety( point ) { return 0.0; };  // lower bound on the distance from a point to the surface
+    virtual double evalCost() { return 2.0; };       // relative cost of eval, for ordering point tests
 };
 
 class plane : public surface {
   private:
     double a, b, c, d;
+    double inv_norm;           // one over the length of the normal
   public:
     plane( std::string label, double p1, double p2, double p3, double p4 ) :   // constructor takes name and plane equation
-      surface(label), a(p1), b(p2), c(p3), d(p4) {};
+      surface(label), a(p1), b(p2), c(p3), d(p4) { inv_norm = 1.0 / std::sqrt( a*a + b*b + c*c ); };
     ~plane() {};               // destructor
 
     double eval( point p );    // return positive, zero or negative
     double distance( ray r );  // return min positive distance to intersection
     point  reflect( ray r );   // return new reflected direction
+    double distanceFrom( ray ) { return std::numeric_limits<double>::max(); }; // a plane is met only once
+    double safety( point p ) { return std::fabs( eval( p ) ) * inv_norm; };
+    int    senseAlong( ray r ) { return a * r.dir.x + b * r.dir.y + c * r.dir.z < 0.0 ? -1 : 1; };
+    bool   convex( int ) { return true; };       // both half spaces are convex
+    double evalCost() { return 1.0; };           // linear, cheaper than the quadrics
+    point  shiftTo( std::shared_ptr< plane > other ); // translation normal to the planes taking this plane onto a parallel one
+};
+
+class planex : public plane { // plane a*x = d, normal to the x axis
+  private:
+    double s, x0;                 // sign of a and position of the plane
+  public:
+    planex( std::string label, double a, double d ) :
+      plane( label, a, 0.0, 0.0, d ), s( std::copysign( 1.0, a ) ), x0( d / a ) {};
+    ~planex() {};
+
+    double eval( point p ) { return s * ( p.x - x0 ); };
+    double distance( ray r ) {
+      if ( std::fabs( r.dir.x ) <= 100.0 * std::numeric_limits<double>::epsilon() ) { return std::numeric_limits<double>::max(); }
+      double dist = ( x0 - r.pos.x ) / r.dir.x;
+      return dist > 0.0 ? dist : std::numeric_limits<double>::max();
+    };
+    point  reflect( ray r ) { point u = r.dir; u.x = -u.x; return u; };
+    int    senseAlong( ray r ) { return s * r.dir.x < 0.0 ? -1 : 1; };
+    double safety( point p ) { return std::fabs( p.x - x0 ); };
+    void   bound( int sense, point& lo, point& hi ) { // half space above or below the plane
+      if ( s * sense > 0 ) { lo.x = std::fmax( lo.x, x0 ); } else { hi.x = std::fmin( hi.x, x0 ); }
+    };
+};
+
+class planey : public plane { // plane a*y = d, normal to the y axis
+  private:
+    double s, y0;                 // sign of a and position of the plane
+  public:
+    planey( std::string label, double a, double d ) :
+      plane( label, 0.0, a, 0.0, d ), s( std::copysign( 1.0, a ) ), y0( d / a ) {};
+    ~planey() {};
+
+    double eval( point p ) { return s * ( p.y - y0 ); };
+    double distance( ray r ) {
+      if ( std::fabs( r.dir.y ) <= 100.0 * std::numeric_limits<double>::epsilon() ) { return std::numeric_limits<double>::max(); }
+      double dist = ( y0 - r.pos.y ) / r.dir.y;
+      return dist > 0.0 ? dist : std::numeric_limits<double>::max();
+    };
+    point  reflect( ray r ) { point u = r.dir; u.y = -u.y; return u; };
+    int    senseAlong( ray r ) { return s * r.dir.y < 0.0 ? -1 : 1; };
+    double safety( point p ) { return std::fabs( p.y - y0 ); };
+    void   bound( int sense, point& lo, point& hi ) { // half space above or below the plane
+      if ( s * sense > 0 ) { lo.y = std::fmax( lo.y, y0 ); } else { hi.y = std::fmin( hi.y, y0 ); }
+    };
+};
+
+class planez : public plane { // plane a*z = d, normal to the z axis
+  private:
+    double s, z0;                 // sign of a and position of the plane
+  public:
+    planez( std::string label, double a, double d ) :
+      plane( label, 0.0, 0.0, a, d ), s( std::copysign( 1.0, a ) ), z0( d / a ) {};
+    ~planez() {};
+
+    double eval( point p ) { return s * ( p.z - z0 ); };
+    double distance( ray r ) {
+      if ( std::fabs( r.dir.z ) <= 100.0 * std::numeric_limits<double>::epsilon() ) { return std::numeric_limits<double>::max(); }
+      double dist = ( z0 - r.pos.z ) / r.dir.z;
+      return dist > 0.0 ? dist : std::numeric_limits<double>::max();
+    };
+    point  reflect( ray r ) { point u = r.dir; u.z = -u.z; return u; };
+    int    senseAlong( ray r ) { return s * r.dir.z < 0.0 ? -1 : 1; };
+    double safety( point p ) { return std::fabs( p.z - z0 ); };
+    void   bound( int sense, point& lo, point& hi ) { // half space above or below the plane
+      if ( s * sense > 0 ) { lo.z = std::fmax( lo.z, z0 ); } else { hi.z = std::fmin( hi.z, z0 ); }
+    };
+};
+
+class box : public surface { // right parallelepiped with faces normal to the axes, negative inside
+  private:
+    double xmin, xmax, ymin, ymax, zmin, zmax;
+    bool  slabs( ray r, double& tnear, double& tfar ); // interval of r inside all three slabs, false if none
+    point normal( point p );                           // outward normal of the face nearest to p
+  public:
+    box( std::string label, double x1, double x2, double y1, double y2, double z1, double z2 ) :
+      surface(label), xmin(x1), xmax(x2), ymin(y1), ymax(y2), zmin(z1), zmax(z2) {};
+    ~box() {};
+
+    double eval( point p );   // largest distance outside any pair of faces, negative inside
+    double distance( ray r ); // entry distance from outside, exit distance from inside
+    point  reflect( ray r );  // flips the direction components normal to the faces it is leaving through
+    double distanceFrom( ray r ); // exit distance when moving in from a face
+    int    senseAlong( ray r );   // sign of the direction along the normal of the nearest face
+    void   bound( int sense, point& lo, point& hi ); // the box itself for its inside
+    double safety( point p ) { return std::fabs( eval( p ) ); }; // nearest face inside, largest excess outside
 };
 
 class sphere : public surface {
@@ -71,6 +192,10 @@ class sphere : public surface {
     double eval( point p );   // return positive, zero or negative
     double distance( ray r ); // return min positive distance to intersection
     point  reflect( ray r );  // return new reflected direction
+    double distanceFrom( ray r ); // the second root, the first being zero
+    int    senseAlong( ray r );   // sign of the direction along the outward normal
+    void   bound( int sense, point& lo, point& hi ); // box around the inside
+    double safety( point p );                        // | distance from the center or axis - radius |
 };
 
 class cylinderx : public surface { // cylinder parrallel to x axis
@@ -84,6 +209,10 @@ class cylinderx : public surface { // cylinder parrallel to x axis
     double eval( point p );   // return positive, zero or negative
     double distance( ray r ); // return min positive distance to intersection
     point  reflect( ray r );  // return new reflected direction
+    double distanceFrom( ray r ); // the second root, the first being zero
+    int    senseAlong( ray r );   // sign of the direction along the outward normal
+    void   bound( int sense, point& lo, point& hi ); // box around the inside
+    double safety( point p );                        // | distance from the center or axis - radius |
 };
 
 class cylinderz : public surface { // cylinder parrallel to z axis
@@ -97,6 +226,10 @@ class cylinderz : public surface { // cylinder parrallel to z axis
     double eval( point p );   // return positive, zero or negative
     double distance( ray r ); // return min positive distance to intersection
     point  reflect( ray r );  // return new reflected direction
+    double distanceFrom( ray r ); // the second root, the first being zero
+    int    senseAlong( ray r );   // sign of the direction along the outward normal
+    void   bound( int sense, point& lo, point& hi ); // box around the inside
+    double safety( point p );                        // | distance from the center or axis - radius |
 };
 
 #endif
@@ -0,0 +1,212 @@
+#include <cmath>
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+
+#include "Tally.h"
+#include "Cell.h"
+#include "Surface.h"
+#include "Material.h"
+
+cell_filter::cell_filter( std::vector< std::shared_ptr< cell > > c, bool born ) :
+  tally_filter( born ? "birthCell" : "cell" ), filter_cells(c), birth(born) {
+  for ( long long b = 0 ; b < (long long) filter_cells.size() ; b++ ) { cell_bin[ filter_cells[b].get() ] = b; }
+}
+
+void cell_filter::match( tally_event& e, filter_matches& m ) {
+  auto b = cell_bin.find( birth ? e.p->birthCell() : e.p->cellPointer().get() );
+  if ( b != cell_bin.end() ) { m.emplace_back( b->second, 1.0 ); }
+}
+
+std::string cell_filter::label( long long b ) { return filter_cells[b]->name(); }
+
+surface_filter::surface_filter( std::vector< std::shared_ptr< surface > > s ) : tally_filter("surface"), filter_surfaces(s) {
+  for ( long long b = 0 ; b < (long long) filter_surfaces.size() ; b++ ) { surface_bin[ filter_surfaces[b].get() ] = b; }
+}
+
+void surface_filter::match( tally_event& e, filter_matches& m ) {
+  if ( e.type != crossing_event ) { return; }
+  auto b = surface_bin.find( e.S );
+  if ( b != surface_bin.end() ) { m.emplace_back( b->second, 1.0 ); }
+}
+
+std::string surface_filter::label( long long b ) { return filter_surfaces[b]->name(); }
+
+void cosine_filter::match( tally_event& e, filter_matches& m ) {
+  point  u = e.p->dir();
+  double mu;
+  if ( normal ) {
+    // reflection takes away twice the normal component, u - u' = 2 ( u.n ) n
+    if ( e.type != crossing_event ) { return; }
+    point v  = e.S->reflect( e.r );
+    point dv = point( u.x - v.x, u.y - v.y, u.z - v.z );
+    mu = 0.5 * std::sqrt( dv.x * dv.x + dv.y * dv.y + dv.z * dv.z );
+  }
+  else {
+    mu = u.x * axis.x + u.y * axis.y + u.z * axis.z;
+  }
+  if ( mu < edges.front() || mu > edges.back() ) { return; }
+  long long b = std::upper_bound( edges.begin(), edges.end(), mu ) - edges.begin() - 1;
+  m.emplace_back( std::min( b, bins() - 1 ), 1.0 );
+}
+
+std::string cosine_filter::label( long long b ) {
+  std::ostringstream s;
+  s << edges[b] << ":" << edges[b+1];
+  return s.str();
+}
+
+void mesh_filter::match( tally_event& e, filter_matches& m ) {
+  if ( e.type == flight_event ) {
+    if ( e.track <= 0.0 ) { return; }
+    double f = 1.0 / e.track;
+    mesh.walk( e.p->pos(), e.p->dir(), e.length, e.decay, [&m,f]( long long v, double x ) { m.emplace_back( v, x * f ); } );
+  }
+  else {
+    long long v = mesh.voxel( e.p->pos() );
+    if ( v >= 0 ) { m.emplace_back( v, 1.0 ); }
+  }
+}
+
+std::string mesh_filter::label( long long b ) {
+  long long nx = mesh.size(0), ny = mesh.size(1);
+  return std::to_string( b % nx ) + "," + std::to_string( ( b / nx ) % ny ) + "," + std::to_string( b / ( nx * ny ) );
+}
+
+static const char* tally_score_names[] = { "flux", "current", "collisions", "total", "absorption", "nu-fission" };
+
+bool tally::knownScore( std::string s ) {
+  for ( auto n : tally_score_names ) { if ( s == n ) { return true; } }
+  return false;
+}
+
+tally::tally( std::string label, std::vector< std::shared_ptr< tally_filter > > f, std::vector< std::string > s, std::string out ) :
+  estimator(label), filters(f), score_names(s), output(out) {
+  for ( auto n : score_names ) {
+    int k = std::find_if( std::begin( tally_score_names ), std::end( tally_score_names ),
+                          [&n]( const char* x ) { return n == x; } ) - std::begin( tally_score_names );
+    scores.push_back( (tally_score_type) k );
+  }
+  needs_xs = hasScore( total_score ) || hasScore( absorption_score ) || hasScore( nu_fission_score );
+
+  // mixed radix: the last filter's bins are adjacent, each filter before it strides over all those after
+  stride.assign( filters.size(), 1 );
+  nbins = 1;
+  for ( int i = (int) filters.size() - 1 ; i >= 0 ; i-- ) {
+    stride[i] = nbins;
+    nbins    *= filters[i]->bins();
+  }
+  matches.assign( filters.size(), filter_matches() );
+  odometer.assign( filters.size(), 0 );
+  values.assign( scores.size(), 0.0 );
+  hist.assign( nbins * scores.size(), 0.0 );
+  sum.assign( nbins * scores.size(), 0.0 );
+  sum_squared.assign( nbins * scores.size(), 0.0 );
+  nhist = 0;
+}
+
+bool tally::hasScore( tally_score_type t ) { return std::find( scores.begin(), scores.end(), t ) != scores.end(); }
+
+void tally::scoreFlight( particle* p, double s, double decay ) {
+  tally_event e( flight_event, p );
+  e.length = s;
+  e.track  = decay == 0.0 ? s : -std::expm1( -decay * s ) / decay;
+  e.decay  = decay;
+
+  std::shared_ptr< material > M = needs_xs ? p->cellPointer()->getMaterial() : nullptr;
+  double wt = p->wgt() * e.track;
+  for ( size_t k = 0 ; k < scores.size() ; k++ ) {
+    switch ( scores[k] ) {
+      case flux_score:       values[k] = wt; break;
+      case total_score:      values[k] = M ? wt * M->macro_xs( p ) : 0.0; break;
+      case absorption_score: values[k] = M ? wt * M->absorption_xs( p ) : 0.0; break;
+      case nu_fission_score: values[k] = M ? wt * M->nu_fission_xs( p ) : 0.0; break;
+      default:               values[k] = 0.0;
+    }
+  }
+  scoreEvent( e );
+}
+
+void tally::scoreCrossing( particle* p, surface* S, ray r ) {
+  tally_event e( crossing_event, p );
+  e.S = S;
+  e.r = r;
+  for ( size_t k = 0 ; k < scores.size() ; k++ ) { values[k] = scores[k] == current_score ? p->wgt() : 0.0; }
+  scoreEvent( e );
+}
+
+void tally::scoreCollision( particle* p ) {
+  tally_event e( collision_event, p );
+  for ( size_t k = 0 ; k < scores.size() ; k++ ) { values[k] = scores[k] == collisions_score ? p->wgt() : 0.0; }
+  scoreEvent( e );
+}
+
+void tally::scoreEvent( tally_event& e ) {
+  // most events score nothing, e.g. flights in a current tally, and never reach the filters
+  bool any = false;
+  for ( auto x : values ) { any = any || x != 0.0; }
+  if ( ! any ) { return; }
+  for ( size_t f = 0 ; f < filters.size() ; f++ ) {
+    matches[f].clear();
+    filters[f]->match( e, matches[f] );
+    if ( matches[f].empty() ) { return; }
+  }
+
+  // every combination of the filters' bins, turning the last filter fastest like an odometer
+  int nf = filters.size();
+  while ( true ) {
+    long long index  = 0;
+    double    weight = 1.0;
+    for ( int f = 0 ; f < nf ; f++ ) {
+      index  += matches[f][ odometer[f] ].first * stride[f];
+      weight *= matches[f][ odometer[f] ].second;
+    }
+    index *= scores.size();
+    for ( size_t k = 0 ; k < scores.size() ; k++ ) {
+      if ( values[k] != 0.0 ) { add( index + k, weight * values[k] ); }
+    }
+    int f = nf - 1;
+    while ( f >= 0 && ++odometer[f] == matches[f].size() ) { odometer[f] = 0; f--; }
+    if ( f < 0 ) { break; }
+  }
+}
+
+void tally::endHistory() {
+  for ( auto v : touched ) {
+    sum[v]         += hist[v];
+    sum_squared[v] += hist[v] * hist[v];
+    hist[v] = 0.0;
+  }
+  touched.clear();
+  nhist++;
+}
+
+void tally::discardHistory() {
+  for ( auto v : touched ) { hist[v] = 0.0; }
+  touched.clear();
+}
+
+void tally::report() {
+  std::ofstream file;
+  if ( ! output.empty() ) { file.open( output ); }
+  std::ostream& out = output.empty() ? std::cout : file;
+
+  // one line per bin and score: the bin of each filter, the score, its mean and relative error
+  out << " " << name() << ", " << nhist << " histories:";
+  for ( auto f : filters ) { out << " " << f->type(); }
+  out << " score mean relative_error" << std::endl;
+  for ( long long b = 0 ; b < nbins ; b++ ) {
+    std::string bin;
+    for ( size_t f = 0 ; f < filters.size() ; f++ ) { bin += " " + filters[f]->label( b / stride[f] % filters[f]->bins() ); }
+    for ( size_t k = 0 ; k < scores.size() ; k++ ) {
+      long long v = b * scores.size() + k;
+      double m = sum[v] / nhist;
+      double r = m != 0.0 ? std::sqrt( std::fmax( 0.0, ( sum_squared[v] / nhist - m * m ) / nhist ) ) / std::fabs( m ) : 0.0;
+      out << "  " << bin << " " << score_names[k] << "   " << m << "   " << r << std::endl;
+    }
+  }
+  if ( ! output.empty() ) {
+    std::cout << " " << name() << "   " << nbins << " bins, " << scores.size() << " scores written to " << output << std::endl;
+  }
+}
@@ -0,0 +1,165 @@
+#ifndef _TALLY_HEADER_
+#define _TALLY_HEADER_
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <utility>
+#include <algorithm>
+#include <unordered_map>
+
+#include "Point.h"
+#include "Particle.h"
+#include "Mesh.h"
+#include "Estimator.h"
+
+class cell;
+class surface;
+
+enum tally_event_type { flight_event, crossing_event, collision_event };
+
+// what filters and scores see of an event
+class tally_event {
+  public:
+    tally_event_type type;
+    particle* p;          // particle at the end of the flight, on the surface, or at the collision
+    double    length;     // flight length
+    double    track;      // flight length with the weight decay of the exponential transform integrated in
+    double    decay;      // that decay, exp( -decay t ) along the flight
+    surface*  S;          // surface crossed (null if none)
+    ray       r;          // position in the surface's coordinates, and direction
+
+    tally_event( tally_event_type t, particle* q ) : type(t), p(q), length(0.0), track(0.0), decay(0.0), S(nullptr), r( q->getRay() ) {};
+    ~tally_event() {};
+};
+
+typedef std::vector< std::pair< long long, double > > filter_matches;  // bins an event falls in, and the fraction of its score each takes
+
+// a filter sorts events into bins: most fall in one bin or none, a flight through a mesh in every voxel it crosses
+class tally_filter {
+  private:
+    std::string filter_type;
+  public:
+     tally_filter( std::string t ) : filter_type(t) {};
+    virtual ~tally_filter() {};
+
+    virtual std::string type() final { return filter_type; };
+    virtual long long   bins() = 0;                                 // number of bins
+    virtual void        match( tally_event& e, filter_matches& m ) = 0; // append the bins e falls in
+    virtual std::string label( long long b ) = 0;                   // bin b in the output
+};
+
+// cell the event happens in, or the cell the particle was born in
+class cell_filter : public tally_filter {
+  private:
+    std::vector< std::shared_ptr< cell > > filter_cells;
+    std::unordered_map< cell*, long long > cell_bin;
+    bool birth;                                               // bin by birth cell
+  public:
+     cell_filter( std::vector< std::shared_ptr< cell > > c, bool born );
+    ~cell_filter() {};
+
+    std::vector< std::shared_ptr< cell > > cells() { return filter_cells; };
+    long long   bins() { return filter_cells.size(); };
+    void        match( tally_event& e, filter_matches& m );
+    std::string label( long long b );
+};
+
+// surface crossed, only crossings fall in its bins
+class surface_filter : public tally_filter {
+  private:
+    std::vector< std::shared_ptr< surface > > filter_surfaces;
+    std::unordered_map< surface*, long long > surface_bin;
+  public:
+     surface_filter( std::vector< std::shared_ptr< surface > > s );
+    ~surface_filter() {};
+
+    std::vector< std::shared_ptr< surface > > surfaces() { return filter_surfaces; };
+    long long   bins() { return filter_surfaces.size(); };
+    void        match( tally_event& e, filter_matches& m );
+    std::string label( long long b );
+};
+
+// cosine of the direction with a fixed axis, or without one its absolute value with the normal of the surface crossed
+class cosine_filter : public tally_filter {
+  private:
+    std::vector< double > edges;                              // increasing bin edges
+    bool  normal;                                             // true if taken with the surface normal
+    point axis;
+  public:
+     cosine_filter( std::vector< double > e ) : tally_filter("cosine"), edges(e), normal(true), axis( 0.0, 0.0, 1.0 ) {};
+     cosine_filter( std::vector< double > e, point u ) : tally_filter("cosine"), edges(e), normal(false), axis(u) { axis.normalize(); };
+    ~cosine_filter() {};
+
+    long long   bins() { return edges.size() - 1; };
+    void        match( tally_event& e, filter_matches& m );
+    std::string label( long long b );
+};
+
+// number of collisions the particle had before the event, the last bin taking any more
+class collision_filter : public tally_filter {
+  private:
+    int n;
+  public:
+     collision_filter( int nbins ) : tally_filter("collisions"), n(nbins) {};
+    ~collision_filter() {};
+
+    long long   bins() { return n; };
+    void        match( tally_event& e, filter_matches& m ) { m.emplace_back( std::min( e.p->collisions(), n - 1 ), 1.0 ); };
+    std::string label( long long b ) { return std::to_string( b ) + ( b == n - 1 ? "+" : "" ); };
+};
+
+// voxel of a Cartesian mesh: a flight is shared among the voxels it crosses, other events fall in the voxel they happen in
+class mesh_filter : public tally_filter {
+  private:
+    cartesian_mesh mesh;
+  public:
+     mesh_filter( cartesian_mesh m ) : tally_filter("mesh"), mesh(m) {};
+    ~mesh_filter() {};
+
+    long long   bins() { return mesh.voxels(); };
+    void        match( tally_event& e, filter_matches& m );
+    std::string label( long long b );
+};
+
+enum tally_score_type { flux_score, current_score, collisions_score, total_score, absorption_score, nu_fission_score };
+
+// a tally is a product of filters times a list of scores: each event is sorted by every filter, the bins it falls
+// in combined into one flat index by mixed radix arithmetic, the first filter varying slowest and the scores fastest,
+// so scoring costs the same whatever the number of bins
+// flux and the reaction rates are track length estimates, current is scored at crossings and collisions at collisions
+class tally : public estimator {
+  private:
+    std::vector< std::shared_ptr< tally_filter > > filters;
+    std::vector< tally_score_type > scores;
+    std::vector< std::string > score_names;
+    std::vector< long long > stride;                   // of each filter's bins in the flat index
+    long long nbins;                                   // product of the filters' bins
+    std::string output;                                // file the results are written to (empty for the screen)
+    bool   needs_xs;                                   // true if a reaction rate is scored
+    std::vector< filter_matches > matches;             // bins of each filter for the event being scored
+    std::vector< size_t > odometer;                    // combination of those being scored
+    std::vector< double > values;                      // of each score for that event
+    std::vector< double > hist, sum, sum_squared;      // scores of the current history, and their sums over histories
+    std::vector< long long > touched;                  // flat indices scored in the current history
+    void add( long long v, double x ) {                // add x to flat index v in the current history
+      if ( hist[v] == 0.0 ) { touched.push_back( v ); }
+      hist[v] += x;
+    };
+    void scoreEvent( tally_event& e );
+  public:
+     tally( std::string label, std::vector< std::shared_ptr< tally_filter > > f, std::vector< std::string > s, std::string out );
+    ~tally() {};
+
+    static bool knownScore( std::string s );                         // true if s names a score
+    bool hasScore( tally_score_type t );                             // true if t is one of the scores
+    void score( particle* ) {};                                      // crossings are scored with their surface
+    void scoreFlight( particle* p, double s, double decay );
+    void scoreCrossing( particle* p, surface* S, ray r );
+    void scoreCollision( particle* p );
+    void endHistory();
+    void discardHistory();
+    void report();                                                   // print or write every bin
+};
+
+#endif
@@ -0,0 +1,60 @@
+#include <algorithm>
+
+#include "VoxelMap.h"
+
+voxel_map::voxel_map( int w, int log2_slots ) : width(w) {
+  shift = 64 - log2_slots;
+  keys.assign( 1ull << log2_slots, -1 );
+  values.assign( ( 1ull << log2_slots ) * width, 0.0 );
+}
+
+double* voxel_map::insert( long long v ) {
+  unsigned long long mask = keys.size() - 1;
+  unsigned long long s    = slot( v );
+  while ( keys[s] != v ) {
+    if ( keys[s] < 0 ) {
+      if ( 2 * ( used.size() + 1 ) > keys.size() ) { grow(); return insert( v ); }
+      keys[s] = v;
+      used.push_back( s );
+      break;
+    }
+    s = ( s + 1 ) & mask;
+  }
+  return &values[ s * width ];
+}
+
+double* voxel_map::find( long long v ) {
+  unsigned long long mask = keys.size() - 1;
+  unsigned long long s    = slot( v );
+  while ( keys[s] != v ) {
+    if ( keys[s] < 0 ) { return nullptr; }
+    s = ( s + 1 ) & mask;
+  }
+  return &values[ s * width ];
+}
+
+void voxel_map::clear() {
+  for ( auto s : used ) {
+    keys[s] = -1;
+    std::fill( values.begin() + s * width, values.begin() + ( s + 1 ) * width, 0.0 );
+  }
+  used.clear();
+}
+
+void voxel_map::grow() {
+  std::vector< long long > old_keys;
+  std::vector< double >    old_values;
+  std::vector< long long > old_used;
+  old_keys.swap( keys );
+  old_values.swap( values );
+  old_used.swap( used );
+
+  shift--;
+  keys.assign( 2 * old_keys.size(), -1 );
+  values.assign( 2 * old_values.size(), 0.0 );
+  used.reserve( old_used.size() );
+  for ( auto s : old_used ) {
+    double* x = insert( old_keys[s] );
+    std::copy( old_values.begin() + s * width, old_values.begin() + ( s + 1 ) * width, x );
+  }
+}
@@ -0,0 +1,33 @@
+#ifndef _VOXELMAP_HEADER_
+#define _VOXELMAP_HEADER_
+
+#include <vector>
+
+// open addressing hash map from voxel index to a fixed number of doubles, for tallies on meshes far too large
+// to store densely; slots are found by Fibonacci hashing and linear probing, the table doubles once half of
+// it is in use, and the stored voxels are listed so iterating or clearing only touches those
+class voxel_map {
+  private:
+    int width;                          // doubles per voxel
+    int shift;                          // 64 - log2( number of slots )
+    std::vector< long long > keys;      // voxel in each slot, -1 if empty
+    std::vector< double >    values;    // width doubles per slot
+    std::vector< long long > used;      // slots in use, in the order they were filled
+    unsigned long long slot( long long v ) { return ( (unsigned long long) v * 11400714819323198485ull ) >> shift; };
+    void grow();                        // double the number of slots
+  public:
+     voxel_map( int w, int log2_slots = 10 );
+    ~voxel_map() {};
+
+    double* insert( long long v );                                           // values of voxel v, zero when first inserted
+    double* find( long long v );                                             // values of voxel v, null if not stored
+    void    clear();                                                         // remove all voxels, keeping the slots
+    unsigned long long size() { return used.size(); };                      // number of voxels stored
+    long long key( unsigned long long i ) { return keys[ used[i] ]; };       // i-th voxel stored
+    double*   at( unsigned long long i ) { return &values[ used[i] * width ]; }; // its values
+    unsigned long long bytes() {                                             // memory in use
+      return keys.capacity() * sizeof( long long ) + values.capacity() * sizeof( double ) + used.capacity() * sizeof( long long );
+    };
+};
+
+#endif
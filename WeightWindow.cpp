@@ -0,0 +1,67 @@
+#include <iostream>
+#include <cmath>
+#include <algorithm>
+#include <sstream>
+
+#include "Random.h"
+#include "WeightWindow.h"
+
+weight_window::weight_window( point lo, point hi, int n1, int n2, int n3, double sr, double ur, int maxs ) :
+  x0(lo.x), y0(lo.y), z0(lo.z), x1(hi.x), y1(hi.y), z1(hi.z), nx(n1), ny(n2), nz(n3), 
+  max_split(maxs), survival_ratio(sr), upper_ratio(ur) {
+  idx = nx / ( x1 - x0 );
+  idy = ny / ( y1 - y0 );
+  idz = nz / ( z1 - z0 );
+  bounds.resize( nx * ny * nz );
+  nsplit = 0; nroulette = 0; nkill = 0;
+}
+
+point weight_window::center( int v ) {
+  int i = v % nx;
+  int j = ( v / nx ) % ny;
+  int k = v / ( nx * ny );
+  return point( x0 + ( i + 0.5 ) / idx, y0 + ( j + 0.5 ) / idy, z0 + ( k + 0.5 ) / idz );
+}
+
+void weight_window::setBounds( int v, double lower ) {
+  bounds[v] = window_bounds( lower, lower * survival_ratio, lower * upper_ratio );
+}
+
+std::string weight_window::attributes() {
+  std::ostringstream a;
+  a << "xmin=\"" << x0 << "\" xmax=\"" << x1 << "\" nx=\"" << nx << "\" "
+    << "ymin=\"" << y0 << "\" ymax=\"" << y1 << "\" ny=\"" << ny << "\" "
+    << "zmin=\"" << z0 << "\" zmax=\"" << z1 << "\" nz=\"" << nz << "\" "
+    << "survival=\"" << survival_ratio << "\" upper=\"" << upper_ratio << "\" maxSplit=\"" << max_split << "\"";
+  return a.str();
+}
+
+// check the particle weight against the window of its voxel
+int weight_window::apply( particle* p, std::stack< particle >* bank ) {
+  int v = index( p->pos() );
+  if ( v < 0 || ! p->alive() ) { return 0; }
+  window_bounds b = bounds[v];
+  if ( b.lower <= 0.0 ) { return 0; }
+
+  double w = p->wgt();
+  if ( w > b.upper ) {
+    // split into n particles of equal weight, the working particle being the last one
+    int n = std::min( max_split, (int) std::ceil( w / b.upper ) );
+    p->adjustWeight( 1.0 / n );
+    for ( int i = 0 ; i < n - 1 ; i++ ) { bank->push( *p ); }
+    nsplit++;
+    return n - 1;
+  }
+  else if ( w < b.lower ) {
+    // roulette to the survival weight
+    nroulette++;
+    if ( Urand() < w / b.survival ) { p->adjustWeight( b.survival / w ); }
+    else { p->kill(); nkill++; }
+  }
+  return 0;
+}
+
+void weight_window::report() {
+  std::cout << " weight windows: " << nsplit << " splits, " << nroulette << " roulettes, "
+            << nkill << " particles killed" << std::endl;
+}
@@ -0,0 +1,61 @@
+#ifndef _WEIGHTWINDOW_HEADER_
+#define _WEIGHTWINDOW_HEADER_
+
+#include <vector>
+#include <stack>
+#include <string>
+#include <cmath>
+#include <algorithm>
+
+#include "Point.h"
+#include "Particle.h"
+
+// lower bound, survival weight and upper bound of one voxel, stored together so a lookup touches one cache line
+class window_bounds {
+  public:
+    double lower, survival, upper;
+
+    window_bounds( double l = 0.0, double s = 0.0, double u = 0.0 ) : lower(l), survival(s), upper(u) {};
+    ~window_bounds() {};
+};
+
+// weight windows on a regular Cartesian mesh; particles above the window are split,
+// particles below are rouletted to the survival weight, a zero lower bound turns the window off
+class weight_window {
+  private:
+    double x0, y0, z0;                        // lower corner of the mesh
+    double x1, y1, z1;                        // upper corner of the mesh
+    int    nx, ny, nz;                        // number of voxels along each axis
+    double idx, idy, idz;                     // inverse voxel widths
+    int    max_split;                         // largest number of particles a single split can create
+    double survival_ratio, upper_ratio;       // survival weight and upper bound relative to the lower bound
+    std::vector< window_bounds > bounds;      // windows, x index varying fastest
+    unsigned long long nsplit, nroulette, nkill; // statistics
+  public:
+     weight_window( point lo, point hi, int n1, int n2, int n3, double sr, double ur, int maxs );
+    ~weight_window() {};
+
+    int  size() { return nx * ny * nz; };                       // number of voxels
+    int  index( point p ) {                                     // voxel containing p, -1 if outside the mesh
+      // the bounds are checked in double before converting, so infinite or NaN coordinates
+      // (which fail every comparison) never reach the conversion to int
+      if ( ! ( p.x >= x0 && p.x < x1 && p.y >= y0 && p.y < y1 && p.z >= z0 && p.z < z1 ) ) { return -1; }
+      int i = std::min( nx - 1, (int) std::floor( ( p.x - x0 ) * idx ) );
+      int j = std::min( ny - 1, (int) std::floor( ( p.y - y0 ) * idy ) );
+      int k = std::min( nz - 1, (int) std::floor( ( p.z - z0 ) * idz ) );
+      return i + nx * ( j + ny * k );
+    };
+    bool  covers( point p ) {                                   // true if p is in a voxel with a window
+      int v = index( p );
+      return v >= 0 && bounds[v].lower > 0.0;
+    };
+    point center( int v );                                      // center of voxel v
+    void setBounds( int v, double lower );                      // set window of voxel v from its lower bound
+    window_bounds getBounds( int v ) { return bounds[v]; };     // window of voxel v
+    double upperRatio() { return upper_ratio; };                // upper bound relative to the lower bound
+    std::string attributes();                                   // mesh and ratios as input attributes
+    int  apply( particle* p, std::stack< particle >* bank );    // split or roulette p, returns number of particles added
+    void report();                                              // print split and roulette statistics
+};
+
+#endif
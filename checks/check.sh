@@ -0,0 +1,41 @@
+#!/bin/sh
+# runs every deck listed in expected.txt and compares the last output line starting with each label
+# to its expected value; the first number after the label is the mean
+# usage: check.sh [executable], run from anywhere, the decks are run from this directory
+cd "$( dirname "$0" )" || exit 1
+exe=$( cd .. && pwd )/HW2.out
+[ -n "$1" ] && exe=$( cd "$( dirname "$1" )" && pwd )/$( basename "$1" )
+
+failed=0
+checked=0
+for deck in $( grep -v '^#' expected.txt | cut -f1 | uniq ); do
+  out=$( echo "$deck" | "$exe" 2>&1 )
+  result=$( printf '%s\n' "$out" | awk -F'\t' -v deck="$deck" '
+    FILENAME == "expected.txt" { if ( $1 == deck ) { n++; label[n] = $2; expect[n] = $3; tol[n] = $4 } next }
+    {
+      sub( /^[ \t]+/, "" )
+      for ( i = 1 ; i <= n ; i++ ) {
+        if ( index( $0, label[i] " " ) == 1 ) {
+          split( substr( $0, length( label[i] ) + 1 ), f, " " )
+          value[i] = f[1]; found[i] = 1
+        }
+      }
+    }
+    END {
+      bad = 0
+      for ( i = 1 ; i <= n ; i++ ) {
+        if ( ! found[i] ) { printf "FAIL %s: no line \"%s\"\n", deck, label[i]; bad++; continue }
+        d = value[i] - expect[i]; if ( d < 0 ) { d = -d }
+        if ( d > tol[i] ) { printf "FAIL %s: %s %s, expected %s +- %s\n", deck, label[i], value[i], expect[i], tol[i]; bad++ }
+        else { printf "ok   %s: %s %s\n", deck, label[i], value[i] }
+      }
+      exit bad
+    }' expected.txt - )
+  bad=$?
+  printf '%s\n' "$result"
+  failed=$(( failed + bad ))
+  checked=$(( checked + $( printf '%s\n' "$result" | wc -l ) ))
+done
+
+echo "$checked values checked, $failed failed"
+[ "$failed" -eq 0 ]